@@ -0,0 +1,153 @@
+#!/bin/sh
+#----------------------------------------------------------------------------------------
+#	SOURCE FILE:	bench.sh - Sweeps the echo servers over loopback
+#
+#	DATE:		October 2026
+#
+#	NOTES:
+#	Run through "make bench". Every server in $SERVERS is started fresh for
+#	each connection count in $CONNS and payload size in $SIZES, loaded by the
+#	event-driven client (tcp_clnt -e) for $DURATION seconds, and stopped.
+#	One row per run goes to $OUT:
+#
+#	server, conns, size, connected, errors, requests_per_s, mb_per_s,
+#	p50_us, p90_us, p99_us, p999_us, max_us, server_cpu_pct, server_rss_kb
+#
+#	Server CPU is user + system time over the run from /proc/<pid>/stat,
+#	in percent of one core; RSS is the server's peak (VmHWM). Set RATE to a
+#	per-connection request rate for open-loop runs; the latency columns then
+#	come from the coordinated-omission corrected ("intended") row.
+#	ARRIVAL is the client's connection schedule (tcp_clnt -a), e.g.
+#	"linear:2" to ramp the connections up over the first two seconds.
+#
+#	mux_svr is select based: past its client limit (FD_SETSIZE less a few)
+#	it stops accepting until clients leave, and it rejects descriptors
+#	select can't watch and connections that arrive on EMFILE. Rows above
+#	about 1000 connections show those clients as errors or as not
+#	connected; mux_svr prints its rejected count when it is stopped.
+#	The select, poll and epoll-lt servers are epoll_svr on the other event
+#	loop backends (-b); select rejects descriptors past FD_SETSIZE.
+#	The udp server is epoll_svr -u, loaded by the client's UDP mode with
+#	the same batch ($BATCH); its conns are the client's logical clients.
+#	epoll-busy is epoll_svr in busy-poll mode (-p $BUSY_POLL usec); compare
+#	its p99 with the epoll rows at the same load, preferably with RATE set
+#	and on a host with a core to spare for the spinning.
+#	TRANSPORTS="tcp unix" repeats every run over a Unix-domain socket; those
+#	rows are labelled with the server name and "-unix" (e.g. epoll-unix),
+#	so loopback TCP and Unix-domain rows line up per connection count. The
+#	udp server is TCP only.
+#----------------------------------------------------------------------------------------
+
+SERVERS=${SERVERS:-"mux epoll epoll-z uring"}
+CONNS=${CONNS:-"10 100 1000 5000"}
+SIZES=${SIZES:-"64 1024 16384"}
+DURATION=${DURATION:-5}
+LOOPS=${LOOPS:-2}		# client event loop threads
+THREADS=${THREADS:-2}		# epoll_svr worker threads
+RATE=${RATE:-}
+ARRIVAL=${ARRIVAL:-}		# burst, linear:seconds or poisson:connects/s
+BATCH=${BATCH:-32}		# datagrams per recvmmsg/sendmmsg in udp runs
+TRANSPORTS=${TRANSPORTS:-tcp}	# tcp and/or unix
+BUSY_POLL=${BUSY_POLL:-200}	# usec epoll-busy spins after its last event
+SOCK=${TMPDIR:-/tmp}/bench.$$.sock
+PORT=${PORT:-7100}
+OUT=${OUT:-bench.csv}
+
+HZ=$(getconf CLK_TCK)
+
+# Allow the client and the server their connection counts
+ulimit -n "$(ulimit -Hn)" 2>/dev/null
+
+# Command line for server $1 on port (or socket path) $2
+server_cmd()
+{
+	case $1 in
+	mux)		echo "./mux_svr $2" ;;
+	epoll)		echo "./epoll_svr -t $THREADS $2" ;;
+	epoll-z)	echo "./epoll_svr -t $THREADS -z $2" ;;
+	epoll-busy)	echo "./epoll_svr -t $THREADS -p $BUSY_POLL $2" ;;
+	select|poll|epoll-lt)
+			echo "./epoll_svr -t $THREADS -b $1 $2" ;;
+	uring)		echo "./uring_svr $2" ;;
+	udp)		echo "./epoll_svr -t $THREADS -u $BATCH $2" ;;
+	*)		echo "bench.sh: unknown server $1" >&2; return 1 ;;
+	esac
+}
+
+# utime + stime of process $1, in clock ticks
+cpu_ticks()
+{
+	# Field 2 (comm) has no spaces for our servers
+	awk '{ print $14 + $15 }' "/proc/$1/stat" 2>/dev/null || echo 0
+}
+
+peak_rss()
+{
+	awk '/^VmHWM:/ { print $2 }' "/proc/$1/status" 2>/dev/null
+}
+
+echo "server, conns, size, connected, errors, requests_per_s, mb_per_s, p50_us, p90_us, p99_us, p999_us, max_us, server_cpu_pct, server_rss_kb" > "$OUT"
+
+for server in $SERVERS
+do
+	server_cmd "$server" 0 > /dev/null || exit 1
+	for transport in $TRANSPORTS
+	do
+		label=$server
+		case $transport in
+		tcp)	;;
+		unix)	[ "$server" = udp ] && continue
+			label=$server-unix ;;
+		*)	echo "bench.sh: unknown transport $transport" >&2; exit 1 ;;
+		esac
+		for conns in $CONNS
+		do
+			for size in $SIZES
+			do
+				# A fresh port per run keeps TIME_WAIT sockets out of the way
+				PORT=$((PORT + 1))
+				endpoint=$PORT
+				target="127.0.0.1 $PORT"
+				if [ "$transport" = unix ]
+				then
+					endpoint=$SOCK
+					target=$SOCK
+				fi
+				$(server_cmd "$server" "$endpoint") > /dev/null 2>&1 &
+				pid=$!
+				sleep 0.5
+				if ! kill -0 $pid 2>/dev/null
+				then
+					echo "bench.sh: $label did not start" >&2
+					continue
+				fi
+
+				udp=
+				[ "$server" = udp ] && udp="-u $BATCH"
+				start=$(cpu_ticks $pid)
+				result=$(./tcp_clnt -e "$LOOPS" -d "$DURATION" -g "fixed:$size" ${RATE:+-r "$RATE"} ${ARRIVAL:+-a "$ARRIVAL"} $udp \
+					$target "$conns" 2>/dev/null)
+				end=$(cpu_ticks $pid)
+				rss=$(peak_rss $pid)
+				# SIGINT is ignored by background jobs of a script
+				kill $pid 2>/dev/null
+				wait $pid 2>/dev/null
+
+				row=rtt
+				[ -n "$RATE" ] && row=intended
+				echo "$result" | awk -F', *' -v server="$label" -v conns="$conns" -v size="$size" \
+					-v row="$row" -v cpu=$(( (end - start) * 100 / HZ / DURATION )) -v rss="${rss:-0}" '
+					BEGIN		{ p50 = p90 = p99 = p999 = max = 0 }
+					/^Clients:/	{ split($2, a, " "); connected = a[1]; split($3, a, " "); errors = a[1] }
+					/^Requests:/	{ split($2, a, " "); rps = a[1]; split($3, a, " "); mbs = a[1] }
+					$1 == row	{ p50 = $4; p90 = $5; p99 = $6; p999 = $7; max = $8 }
+					END {
+						printf "%s, %s, %s, %d, %d, %d, %.2f, %s, %s, %s, %s, %s, %s, %s\n",
+							server, conns, size, connected, errors, rps, mbs,
+							p50, p90, p99, p999, max, cpu, rss
+					}' | tee -a "$OUT"
+			done
+		done
+	done
+done
+rm -f "$SOCK"
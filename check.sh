@@ -0,0 +1,92 @@
+#!/bin/bash
+#----------------------------------------------------------------------------------------
+#	SOURCE FILE:	check.sh - Regression checks for the echo servers
+#
+#	DATE:		October 2026
+#
+#	NOTES:
+#	Run through "make check". Each check starts a server on $PORT, runs a
+#	thread-mode client against it with a time limit of $LIMIT seconds and
+#	fails if the client doesn't finish cleanly.
+#
+#	pipeline: pipelined 64 KB frames fill the output past WBUF_HIGH, which
+#	pauses reading while input is still buffered. A flush that drains the
+#	output must resume reading; on edge-triggered epoll no further event
+#	would come and the connection would hang.
+#
+#	stalled: the same load while another client sends $STALL_FRAMES 64 KB
+#	frames and never reads an echo. The server must stop reading that
+#	client rather than block on it or buffer without bound, and keep
+#	serving the others. The stalled client is a bash /dev/tcp descriptor.
+#----------------------------------------------------------------------------------------
+
+PORT=${PORT:-7200}
+LIMIT=${LIMIT:-10}
+STALL_FRAMES=${STALL_FRAMES:-256}
+failed=0
+
+# Sends frames without reading the echoes, until killed
+stall()
+{
+	exec 3<>/dev/tcp/127.0.0.1/$PORT || return
+	for i in $(seq $STALL_FRAMES)
+	do
+		printf '\001\001\000\000'
+		head -c 65536 /dev/zero
+	done >&3 2>/dev/null
+	sleep "$LIMIT"
+}
+
+# Runs server command $2 and client arguments $3...; "stalled" in label $1
+# adds a client that doesn't read
+check()
+{
+	label=$1
+	server=$2
+	shift 2
+	$server $PORT > /dev/null 2>&1 &
+	pid=$!
+	sleep 0.5
+	staller=
+	case $label in
+	stalled*)
+		stall &
+		staller=$!
+		sleep 0.5 ;;
+	esac
+	if timeout "$LIMIT" ./tcp_clnt "$@" 127.0.0.1 $PORT 4 | grep -q '^Clients: 4 threads, 4 connected, 0 errors'
+	then
+		echo "ok    $label"
+	else
+		echo "FAIL  $label"
+		failed=1
+	fi
+	[ -n "$staller" ] && kill $staller 2>/dev/null
+	stop $pid
+	wait $pid $staller 2>/dev/null
+}
+
+# Stops server $1, forcibly if it is stuck and doesn't exit within a second
+stop()
+{
+	kill $1 2>/dev/null
+	for i in 1 2 3 4 5 6 7 8 9 10
+	do
+		kill -0 $1 2>/dev/null || return
+		sleep 0.1
+	done
+	echo "      server did not stop" >&2
+	kill -9 $1 2>/dev/null
+}
+
+for backend in epoll-et epoll-lt poll
+do
+	check "pipeline epoll_svr -b $backend" "./epoll_svr -b $backend" -g fixed:65536 -n 64 -P 64
+done
+check "pipeline epoll_svr -z" "./epoll_svr -z" -g fixed:65536 -n 64 -P 64
+check "pipeline uring_svr" "./uring_svr" -g fixed:65536 -n 64 -P 64
+check "pipeline mux_svr" "./mux_svr" -g fixed:65536 -n 64 -P 64
+check "stalled mux_svr" "./mux_svr" -g fixed:65536 -n 64 -P 64
+check "stalled epoll_svr" "./epoll_svr" -g fixed:65536 -n 64 -P 64
+
+exit $failed
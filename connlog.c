@@ -0,0 +1,196 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		connlog.c -   Asynchronous binary log of connection summaries
+--
+--	FUNCTIONS:		ConnLogOpen
+--				ConnLogPut
+--				ConnLogClose
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See connlog.h. Each ring has a head written only by its producer and a
+--	tail written only by the drain thread, on separate cache lines. The
+--	producer publishes a record with a release store of head; the drain
+--	thread hands the slots to the kernel and only then releases them with
+--	a release store of tail. ConnLogClose drains whatever the producers left
+--	before it closes the file; records still in the rings when the process
+--	is killed without it are lost, at most CONNLOG_IDLE_MS worth.
+---------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "connlog.h"
+
+#define CACHE_LINE	64
+#define RING_MASK	(CONNLOG_RING - 1)
+
+struct LogRing
+{
+	uint64_t head __attribute__ ((aligned (CACHE_LINE)));	// next slot to fill
+	uint64_t tail __attribute__ ((aligned (CACHE_LINE)));	// next slot to drain
+	struct ConnRecord slots[CONNLOG_RING] __attribute__ ((aligned (CACHE_LINE)));
+};
+
+struct ConnLog
+{
+	int fd;
+	int count;
+	int stop;			// set by ConnLogClose
+	pthread_t thread;
+	struct LogRing *rings;
+};
+
+// Writes every record published in ring r; returns how many.
+static uint64_t Drain (struct ConnLog *log, struct LogRing *r)
+{
+	struct iovec iov[2];
+	uint64_t tail = r->tail;
+	uint64_t head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+	uint64_t n = head - tail, first;
+	size_t want, done = 0;
+	ssize_t w;
+	int iovcnt = 1;
+
+	if (n == 0)
+		return 0;
+
+	// The published run may wrap around the end of the ring
+	first = CONNLOG_RING - (tail & RING_MASK);
+	if (first > n)
+		first = n;
+	iov[0].iov_base = &r->slots[tail & RING_MASK];
+	iov[0].iov_len = first * sizeof (struct ConnRecord);
+	if (first < n)
+	{
+		iov[1].iov_base = &r->slots[0];
+		iov[1].iov_len = (n - first) * sizeof (struct ConnRecord);
+		iovcnt = 2;
+	}
+	want = n * sizeof (struct ConnRecord);
+
+	while (done < want)
+	{
+		if ((w = writev (log->fd, iov, iovcnt)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			perror ("connlog write");
+			break;		// the records are dropped
+		}
+		done += w;
+		// Skip what went out
+		while (iovcnt > 0 && (size_t) w >= iov[0].iov_len)
+		{
+			w -= iov[0].iov_len;
+			iov[0] = iov[1];
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			iov[0].iov_base = (char *) iov[0].iov_base + w;
+			iov[0].iov_len -= w;
+		}
+	}
+
+	__atomic_store_n (&r->tail, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+static void *DrainLoop (void *arg)
+{
+	struct ConnLog *log = arg;
+	struct timespec idle = { 0, CONNLOG_IDLE_MS * 1000000L };
+	uint64_t n;
+	int i;
+
+	while (!__atomic_load_n (&log->stop, __ATOMIC_ACQUIRE))
+	{
+		n = 0;
+		for (i = 0; i < log->count; i++)
+			n += Drain (log, &log->rings[i]);
+		if (n == 0)
+			nanosleep (&idle, NULL);
+	}
+
+	// The producers are done; take what they left
+	for (i = 0; i < log->count; i++)
+		Drain (log, &log->rings[i]);
+	return NULL;
+}
+
+// Creates (truncates) the log file at path, with one ring for each of the
+// producers threads, and starts the drain thread. Returns NULL with errno
+// set on failure.
+struct ConnLog *ConnLogOpen (const char *path, int producers)
+{
+	struct ConnLog *log;
+	struct ConnLogHeader hdr;
+	if ((log = calloc (1, sizeof (*log))) == NULL)
+		return NULL;
+	log->count = producers;
+	if (posix_memalign ((void **) &log->rings, CACHE_LINE, producers * sizeof (struct LogRing)) != 0)
+	{
+		free (log);
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset (log->rings, 0, producers * sizeof (struct LogRing));
+
+	if ((log->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1)
+		goto fail;
+	memset (&hdr, 0, sizeof (hdr));
+	memcpy (hdr.magic, CONNLOG_MAGIC, sizeof (hdr.magic));
+	hdr.version = CONNLOG_VERSION;
+	hdr.record_size = sizeof (struct ConnRecord);
+	if (write (log->fd, &hdr, sizeof (hdr)) != sizeof (hdr))
+		goto fail;
+
+	if ((errno = pthread_create (&log->thread, NULL, DrainLoop, log)) != 0)
+		goto fail;
+	return log;
+
+fail:
+	if (log->fd != -1)
+		close (log->fd);
+	free (log->rings);
+	free (log);
+	return NULL;
+}
+
+// Queues r on producer's ring. Only that producer's thread may call this.
+// Returns 0, or -1 if the ring is full and the record was dropped.
+int ConnLogPut (struct ConnLog *log, int producer, const struct ConnRecord *r)
+{
+	struct LogRing *ring = &log->rings[producer];
+	uint64_t head = ring->head;
+
+	if (head - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) == CONNLOG_RING)
+		return -1;
+	ring->slots[head & RING_MASK] = *r;
+	__atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+// Stops the drain thread once it has written every record queued so far,
+// closes the file and frees log. The producers must have stopped putting.
+// Returns 0, or -1 if the file could not be closed cleanly.
+int ConnLogClose (struct ConnLog *log)
+{
+	int rc;
+
+	__atomic_store_n (&log->stop, 1, __ATOMIC_RELEASE);
+	pthread_join (log->thread, NULL);
+	if ((rc = close (log->fd)) == -1)
+		perror ("connlog close");
+	free (log->rings);
+	free (log);
+	return rc;
+}
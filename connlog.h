@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		connlog.h -   Asynchronous binary log of connection summaries
+--
+--	FUNCTIONS:		ConnLogOpen
+--				ConnLogPut
+--				ConnLogClose
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	The servers record one struct ConnRecord per closed connection. An
+--	event-loop thread hands its record to ConnLogPut, which copies it into
+--	that thread's single-producer single-consumer ring and returns: no lock,
+--	no system call, no stdio. A background thread drains every ring to the
+--	log file with writev straight from the ring slots. When a ring is full
+--	the record is dropped and ConnLogPut says so; the event loop never waits.
+--	On a graceful stop ConnLogClose writes out what is left in the rings.
+--
+--	The file starts with a struct ConnLogHeader followed by the records in
+--	host byte order. logcsv converts it to the svr.csv layout:
+--
+--		client number, ip:port, seconds, requests, bytes
+--
+--	Seconds is the connection's lifetime on the monotonic clock; the time
+--	the server spent serving it (active_secs) is printed by logcsv -x.
+---------------------------------------------------------------------------------------*/
+#ifndef CONNLOG_H
+#define CONNLOG_H
+
+#include <stdint.h>
+
+#define CONNLOG_MAGIC		"CLOG"
+#define CONNLOG_VERSION		2
+#define CONNLOG_RING		4096	// records per producer ring, a power of 2
+#define CONNLOG_IDLE_MS		10	// drain thread sleep when every ring is empty
+
+struct ConnLogHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t record_size;		// sizeof (struct ConnRecord)
+	uint32_t reserved;
+};
+
+struct ConnRecord
+{
+	uint32_t number;		// client number, in accept order
+	uint32_t ip;			// IPv4 address, network byte order
+	uint16_t port;
+	uint16_t thread;		// event-loop thread that served it
+	uint32_t requests;
+	double secs;			// time the connection was open (monotonic)
+	double active_secs;		// of which spent serving it
+	uint64_t bytes;			// payload bytes echoed
+	uint64_t spliced;		// of which relayed without a copy
+};
+
+struct ConnLog;
+
+struct ConnLog *ConnLogOpen (const char *path, int producers);
+int ConnLogPut (struct ConnLog *log, int producer, const struct ConnRecord *r);
+int ConnLogClose (struct ConnLog *log);
+
+#endif
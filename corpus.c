@@ -0,0 +1,202 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		corpus.c -   Shared read-only message corpus for the clients
+--
+--	FUNCTIONS:		CorpusLoad
+--				CorpusGenerate
+--				CorpusFree
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See corpus.h. The frame buffer is an anonymous mapping that is made
+--	read-only once filled; the source file is mapped only while it is
+--	split. Functions return 0, or -1 with errno set.
+---------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "corpus.h"
+
+#define CORPUS_SEED	1
+
+// Length of the message starting at data: the next chunk of size bytes,
+// or with size 0 the next line (cut at CORPUS_LINE - 1 bytes like fgets).
+static size_t NextPiece (const char *data, size_t avail, size_t size)
+{
+	const char *nl;
+	size_t max = size ? size : CORPUS_LINE - 1;
+
+	if (max > avail)
+		max = avail;
+	if (size == 0 && (nl = memchr (data, '\n', max)) != NULL)
+		return nl - data + 1;
+	return max;
+}
+
+// Sets up room for count messages with payload_total bytes in all.
+static int Alloc (struct Corpus *c, size_t count, size_t payload_total)
+{
+	memset (c, 0, sizeof (*c));
+	if (count == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if ((c->msgs = malloc (count * sizeof (struct CorpusMsg))) == NULL)
+		return -1;
+	c->frames_len = count * FRAME_HDRLEN + payload_total;
+	c->frames = mmap (NULL, c->frames_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (c->frames == MAP_FAILED)
+	{
+		c->frames = NULL;
+		free (c->msgs);
+		c->msgs = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+// Appends message c->count with its header; returns where its payload goes.
+static char *Append (struct Corpus *c, size_t *off, uint32_t len)
+{
+	struct CorpusMsg *m = &c->msgs[c->count++];
+
+	m->off = *off;
+	m->len = len;
+	FrameHeader ((unsigned char *) c->frames + *off, FRAME_DATA, len);
+	*off += FRAME_HDRLEN + len;
+	if (len > c->max_len)
+		c->max_len = len;
+	return c->frames + m->off + FRAME_HDRLEN;
+}
+
+int CorpusLoad (struct Corpus *c, const char *path, size_t size)
+{
+	struct stat st;
+	char *map;
+	size_t pos, n, count = 0, off = 0;
+	int fd;
+
+	if (size > FRAME_MAXLEN)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		return -1;
+	if (fstat (fd, &st) == -1)
+	{
+		close (fd);
+		return -1;
+	}
+	if (st.st_size == 0)
+	{
+		close (fd);
+		errno = EINVAL;
+		return -1;
+	}
+	map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	// Count first so the frames fit one mapping
+	for (pos = 0; pos < (size_t) st.st_size; pos += NextPiece (map + pos, st.st_size - pos, size))
+		count++;
+	if (Alloc (c, count, st.st_size) == -1)
+	{
+		munmap (map, st.st_size);
+		return -1;
+	}
+	for (pos = 0; pos < (size_t) st.st_size; pos += n)
+	{
+		n = NextPiece (map + pos, st.st_size - pos, size);
+		memcpy (Append (c, &off, n), map + pos, n);
+	}
+	munmap (map, st.st_size);
+	return mprotect (c->frames, c->frames_len, PROT_READ);
+}
+
+// Uniform in [0, 1)
+static double Uniform (unsigned int *seed)
+{
+	return (rand_r (seed) + (double) rand_r (seed) / (RAND_MAX + 1.0)) / (RAND_MAX + 1.0);
+}
+
+int CorpusGenerate (struct Corpus *c, const char *spec, size_t count)
+{
+	static const char pattern[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789\n";
+	unsigned int seed = CORPUS_SEED;
+	double a = 0, b = 0, pct = 0, v;
+	size_t i, j, off = 0, total = 0;
+	uint32_t *lens;
+	char *p;
+	int pass;
+
+	if (sscanf (spec, "fixed:%lf", &a) == 1)
+		b = a;
+	else if (sscanf (spec, "uniform:%lf:%lf", &a, &b) == 2 && a <= b)
+		;
+	else if (sscanf (spec, "exp:%lf", &a) == 1 && a > 0)
+		;
+	else if (sscanf (spec, "bimodal:%lf:%lf:%lf", &a, &b, &pct) == 3)
+		;
+	else
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if ((lens = malloc (count * sizeof (uint32_t))) == NULL)
+		return -1;
+
+	for (i = 0; i < count; i++)
+	{
+		if (strncmp (spec, "uniform", 7) == 0)
+			v = a + Uniform (&seed) * (b - a + 1);
+		else if (strncmp (spec, "exp", 3) == 0)
+			v = -a * log (1.0 - Uniform (&seed)) + 1;
+		else if (strncmp (spec, "bimodal", 7) == 0)
+			v = Uniform (&seed) * 100 < pct ? b : a;
+		else
+			v = a;
+		if (v < 1)
+			v = 1;
+		if (v > FRAME_MAXLEN)
+			v = FRAME_MAXLEN;
+		lens[i] = (uint32_t) v;
+		total += lens[i];
+	}
+
+	if (Alloc (c, count, total) == -1)
+	{
+		free (lens);
+		return -1;
+	}
+	for (i = 0; i < count; i++)
+	{
+		p = Append (c, &off, lens[i]);
+		for (j = 0; j < lens[i]; j += pass)
+		{
+			pass = lens[i] - j < sizeof (pattern) - 1 ? lens[i] - j : sizeof (pattern) - 1;
+			memcpy (p + j, pattern, pass);
+		}
+	}
+	free (lens);
+	return mprotect (c->frames, c->frames_len, PROT_READ);
+}
+
+void CorpusFree (struct Corpus *c)
+{
+	if (c->frames)
+		munmap (c->frames, c->frames_len);
+	free (c->msgs);
+	memset (c, 0, sizeof (*c));
+}
@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		corpus.h -   Shared read-only message corpus for the clients
+--
+--	FUNCTIONS:		CorpusLoad
+--				CorpusGenerate
+--				CorpusFree
+--				CorpusFrame
+--				CorpusFrameLen
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	A corpus is built once at start-up and then only read, so every client
+--	thread and connection shares it without locking. The messages are
+--	stored as ready-to-send FRAME_DATA frames laid end to end in one
+--	buffer: a client sends a message, or a pipelined run of consecutive
+--	messages, straight from it.
+--
+--	CorpusLoad maps a file and splits it into lines (at most
+--	CORPUS_LINE - 1 bytes each, like fgets) or into fixed-size chunks.
+--	CorpusGenerate makes count messages whose sizes follow a distribution:
+--
+--		fixed:N			every message N bytes
+--		uniform:MIN:MAX		uniform between MIN and MAX
+--		exp:MEAN		exponential with the given mean
+--		bimodal:SMALL:LARGE:PCT	LARGE bytes PCT percent of the time,
+--					SMALL otherwise
+--
+--	Sizes are clamped to 1..FRAME_MAXLEN and drawn from a fixed seed, so a
+--	spec always produces the same corpus.
+---------------------------------------------------------------------------------------*/
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+#define CORPUS_LINE	80	// line mode splits like fgets with this buffer size
+
+struct CorpusMsg
+{
+	size_t off;		// offset of the frame in Corpus.frames
+	uint32_t len;		// payload length
+};
+
+struct Corpus
+{
+	char *frames;		// every message as a frame, back to back
+	size_t frames_len;
+	struct CorpusMsg *msgs;
+	size_t count;
+	size_t max_len;		// largest payload
+};
+
+int CorpusLoad (struct Corpus *c, const char *path, size_t size);
+int CorpusGenerate (struct Corpus *c, const char *spec, size_t count);
+void CorpusFree (struct Corpus *c);
+
+// Frame (header and payload) of message i
+static inline const char *CorpusFrame (const struct Corpus *c, size_t i)
+{
+	return c->frames + c->msgs[i].off;
+}
+
+static inline size_t CorpusFrameLen (const struct Corpus *c, size_t i)
+{
+	return FRAME_HDRLEN + c->msgs[i].len;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		endpoint.h -   Unix-domain stream endpoints
+--
+--	FUNCTIONS:		EndpointIsPath
+--				EndpointUnixAddr
+--				EndpointListenUnix
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Every server takes a Unix-domain socket path where it takes a port, and
+--	the clients take one where they take a host. An argument containing a
+--	'/' is a path ("./echo.sock", "/tmp/echo.sock"); anything else is a
+--	port or a host as before. The framed protocol (frame.h) is the same on
+--	either transport. Unix-domain clients have no address, so the servers
+--	log them as 0.0.0.0:0.
+---------------------------------------------------------------------------------------*/
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// True if arg names a Unix-domain socket rather than a port or a host.
+static inline int EndpointIsPath (const char *arg)
+{
+	return strchr (arg, '/') != NULL;
+}
+
+// Fills addr with the Unix-domain address of path. Returns the address
+// length, or 0 with errno set if path is too long for sun_path.
+static inline socklen_t EndpointUnixAddr (struct sockaddr_un *addr, const char *path)
+{
+	size_t len = strlen (path);
+
+	if (len >= sizeof (addr->sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+	memset (addr, 0, sizeof (*addr));
+	addr->sun_family = AF_UNIX;
+	memcpy (addr->sun_path, path, len + 1);
+	return offsetof (struct sockaddr_un, sun_path) + len + 1;
+}
+
+// Creates a stream socket listening at path. A socket left there by an
+// earlier run is replaced; any other file is left alone and bind fails.
+// flags are or'ed into the socket type (SOCK_NONBLOCK, SOCK_CLOEXEC).
+// Returns the descriptor, or -1 with errno set.
+static inline int EndpointListenUnix (const char *path, int flags)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	socklen_t len;
+	int fd, err;
+
+	if ((len = EndpointUnixAddr (&addr, path)) == 0)
+		return -1;
+	if ((fd = socket (AF_UNIX, SOCK_STREAM | flags, 0)) == -1)
+		return -1;
+	if (lstat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+		unlink (path);
+	if (bind (fd, (struct sockaddr *) &addr, len) == -1 || listen (fd, SOMAXCONN) == -1)
+	{
+		err = errno;
+		close (fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+#endif
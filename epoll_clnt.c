@@ -12,6 +12,11 @@
 --				January 2005
 --				Modified the read loop to use fgets.
 --				While loop is based on the buffer length
+--				October 2026
+--				Sends a length-prefixed frame (frame.h) and ends the
+--				session with a close frame
+--				Connects to a Unix-domain socket when given a path
+--				instead of a host (endpoint.h)
 --
 --
 --	DESIGNERS:		Aman Abdulla
@@ -37,18 +42,25 @@
 #include <strings.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <string.h>
+#include "frame.h"
+#include "endpoint.h"
 
 #define SERVER_TCP_PORT 7000 // Default port
 #define BUFLEN 80			 // Buffer length
 
 int main(int argc, char **argv)
 {
-	int n, bytes_to_read;
+	int type;
 	int sd, port;
 	struct hostent *hp;
 	struct sockaddr_in server;
-	char *host, *bp, rbuf[BUFLEN], sbuf[BUFLEN], **pptr;
+	struct sockaddr_un local;
+	socklen_t local_len;
+	char *host, *rbuf, sbuf[BUFLEN], **pptr;
 	char str[16];
+	size_t rcap = BUFLEN;
+	uint32_t rlen = 0;
 
 	switch (argc)
 	{
@@ -61,57 +73,81 @@ int main(int argc, char **argv)
 		port = atoi(argv[2]); // User specified port
 		break;
 	default:
-		fprintf(stderr, "Usage: %s host [port]\n", argv[0]);
+		fprintf(stderr, "Usage: %s host [port] | socket path\n", argv[0]);
 		exit(1);
 	}
 
-	// Create the socket
-	if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+	// A path names a Unix-domain server on this host
+	if (EndpointIsPath(host))
 	{
-		perror("Cannot create socket");
-		exit(1);
+		if ((local_len = EndpointUnixAddr(&local, host)) == 0 || (sd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+			|| connect(sd, (struct sockaddr *)&local, local_len) == -1)
+		{
+			perror(host);
+			exit(1);
+		}
+		printf("Connected:    Server Socket: %s\n", host);
 	}
-	bzero((char *)&server, sizeof(struct sockaddr_in));
-	server.sin_family = AF_INET;
-	server.sin_port = htons(port);
-	if ((hp = gethostbyname(host)) == NULL)
+	else
 	{
-		fprintf(stderr, "Unknown server address\n");
-		exit(1);
-	}
-	bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
+		// Create the socket
+		if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		{
+			perror("Cannot create socket");
+			exit(1);
+		}
+		bzero((char *)&server, sizeof(struct sockaddr_in));
+		server.sin_family = AF_INET;
+		server.sin_port = htons(port);
+		if ((hp = gethostbyname(host)) == NULL)
+		{
+			fprintf(stderr, "Unknown server address\n");
+			exit(1);
+		}
+		bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
 
-	// Connecting to the server
-	if (connect(sd, (struct sockaddr *)&server, sizeof(server)) == -1)
-	{
-		fprintf(stderr, "Can't connect to server\n");
-		perror("connect");
-		exit(1);
+		// Connecting to the server
+		if (connect(sd, (struct sockaddr *)&server, sizeof(server)) == -1)
+		{
+			fprintf(stderr, "Can't connect to server\n");
+			perror("connect");
+			exit(1);
+		}
+		printf("Connected:    Server Name: %s\n", hp->h_name);
+		pptr = hp->h_addr_list;
+		printf("\t\tIP Address: %s\n", inet_ntop(hp->h_addrtype, *pptr, str, sizeof(str)));
 	}
-	printf("Connected:    Server Name: %s\n", hp->h_name);
-	pptr = hp->h_addr_list;
-	printf("\t\tIP Address: %s\n", inet_ntop(hp->h_addrtype, *pptr, str, sizeof(str)));
 	printf("Transmit:\n");
 
 	// get user's text
 	fgets(sbuf, BUFLEN, stdin);
 
 	// Transmit data through the socket
-	send(sd, sbuf, BUFLEN, 0);
+	if (FrameSend(sd, FRAME_DATA, sbuf, strlen(sbuf)) == -1)
+	{
+		perror("send");
+		exit(1);
+	}
 
 	printf("Receive:\n");
-	bp = rbuf;
-	bytes_to_read = BUFLEN;
+	if ((rbuf = malloc(rcap)) == NULL)
+	{
+		perror("malloc");
+		exit(1);
+	}
 
-	// client makes repeated calls to recv until no more data is expected to arrive.
-	n = 0;
-	while ((n = recv(sd, bp, bytes_to_read, 0)) < BUFLEN)
+	// client waits for the whole echoed frame
+	if (FrameRecv(sd, &type, &rbuf, &rcap, &rlen) != 1)
 	{
-		bp += n;
-		bytes_to_read -= n;
+		fprintf(stderr, "Connection closed by server\n");
+		exit(1);
 	}
-	printf("%s\n", rbuf);
+	printf("%.*s\n", (int) rlen, rbuf);
 	fflush(stdout);
+
+	// End the session so the server logs and closes the connection
+	FrameSend(sd, FRAME_CLOSE, NULL, 0);
+	free(rbuf);
 	close(sd);
 	return (0);
 }
@@ -2,13 +2,20 @@
 --	SOURCE FILE:		epoll_svr.c -   A simple echo server using the epoll API
 --
 --	PROGRAM:		epolls
---				gcc -Wall -ggdb -o epolls epoll_svr.c
+--				gcc -Wall -ggdb -o epolls epoll_svr.c pool.c metrics.c hist.c evloop.c wheel.c connlog.c tsc.c -lpthread
 --
 --	FUNCTIONS:		Berkeley Socket API
 --
 --	DATE:			February 2, 2008
 --
 --	REVISIONS:		(Date and Description)
+--				October 2026
+--				Worker threads (-t), each with its own listener and
+--				event loop; length-prefixed frames (frame.h) served by a
+--				non-blocking per-connection state machine; gathered
+--				writes, timeouts, admission control, zero-copy (-z),
+--				UDP (-u), Unix-domain and CPU-pinned modes; a binary
+--				connection log and live per-thread metrics
 --
 --	DESIGNERS:		Design based on various code snippets found on C10K links
 --				Modified and improved: Aman Abdulla - February 2008
@@ -18,21 +25,32 @@
 --	NOTES:
 --	The program will accept TCP connections from client machines.
 -- 	The program will read data from the client socket and simply echo it back.
---	Design is a simple, single-threaded server using non-blocking, edge-triggered
---	I/O to handle simultaneous inbound connections.
+--	Design is a server using non-blocking I/O with one event loop per worker
+--	thread: each worker has its own SO_REUSEPORT listener, readiness backend
+--	(-b, evloop.c) and pool of connections, and sends the replies of a pass
+--	with one write per connection. Closed connections are logged to -l
+--	("logcsv epoll_svr.log" prints them) and live counters are served on -s.
+--	SIGINT or SIGTERM stops the workers and drains the log.
 --	Test with accompanying client application: epoll_clnt.c
 ---------------------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE		// accept4, splice
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/filter.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <netdb.h>
 #include <strings.h>
@@ -41,65 +59,456 @@
 #include <signal.h>
 #include <pthread.h>
 #include <time.h>
+#include "frame.h"
+#include "pool.h"
+#include "metrics.h"
+#include "evloop.h"
+#include "wheel.h"
+#include "connlog.h"
+#include "tsc.h"
+#include "endpoint.h"
 
 #define TRUE 		1
 #define FALSE 		0
-#define EPOLL_QUEUE_LEN	30000
-#define BUFLEN		80
+#define MAX_EVENTS	1024		// events taken per wait call
 #define SERVER_PORT	7000
+#define MAX_WORKERS	256
+#define CACHE_LINE	64
+#define READ_CHUNK	16384		// bytes asked of recv() per call
+#define WBUF_HIGH	262144		// stop reading while this much output is queued
+#define PIPE_SIZE	262144		// requested capacity of zero-copy relay pipes
+#define PIPE_POOL_MAX	1024		// idle pipes kept per worker
+#define WCHUNK		16384		// output queue chunk size
+#define FLUSH_HIGH	65536		// flush at once when this much output is queued
+#define FLUSH_IOV	64		// chunks gathered per sendmsg
+#define TICK_MS		10		// timer wheel resolution
+#define HANDSHAKE_TIMEOUT 10		// default seconds to the first frame
+#define IDLE_TIMEOUT	60		// default seconds without input
+#define LOG_FILE	"epoll_svr.log"	// default connection log (see logcsv.c)
+#define RUSAGE_MS	1		// least time between thread CPU samples
+#define FD_RESERVE	64		// descriptors kept back from the connection limit
+#define RESUME_PCT	90		// accepting resumes below this share of the limit
+#define ACCEPT_RETRY_MS	100		// pause after EMFILE with no spare descriptor
+#define UDP_BATCH_MAX	1024		// datagrams per recvmmsg/sendmmsg (UIO_MAXIOV)
+#define UDP_MAXLEN	65536		// receive slot per datagram
+#define UDP_RCVBUF	4194304		// socket buffer asked for, capped by rmem_max
+#define BUSY_PAUSE_MAX	1024		// spin-wait hints between empty busy polls
+
+// One link of a connection's output queue. Replies are appended to the
+// tail chunk; a reply larger than WCHUNK gets a chunk of its own size.
+struct OutChunk
+{
+	struct OutChunk *next;
+	size_t off;			// bytes already sent
+	size_t len;			// bytes queued
+	size_t cap;
+	char data[];
+};
+
+// Per-connection state, allocated from the worker's pool and reached through
+// epoll_event.data.ptr. Input is read into the worker's scratch buffer; only
+// a partial frame is kept in rbuf until the rest arrives. Replies are queued
+// in a chain of chunks and sent at the end of the event-loop pass, all of
+// them in one sendmsg. Buffers are allocated on demand, so an idle
+// connection costs this struct and at most one empty chunk.
+struct Connection
+{
+	int fd;
+	int port;
+	struct in_addr ip;
+	uint32_t number;		// client number, in accept order
+	uint64_t accepted_at;		// ns
+	uint64_t active;		// TSC ticks spent serving it
+	int requests;
+	size_t bytes;			// payload bytes echoed
+
+	char *rbuf;
+	size_t rcap;
+	size_t rlen;			// bytes of a partial frame held in rbuf
+	size_t rneed;			// size of that frame, once its header is in
+	struct OutChunk *whead;		// output queue, sent from the head
+	struct OutChunk *wtail;
+	size_t wqueued;			// bytes queued and not yet sent
+
+	int read_blocked;		// reading paused until the output drains
+	int write_blocked;		// the last write hit EAGAIN
+	int closing;			// end of session seen, close once the output drains
+	int interest;			// EV_READ/EV_WRITE registered (level-triggered)
+	int corked;			// TCP_CORK set (-C)
+
+	// Worker's list of connections with replies waiting for the flush
+	struct Connection *flush_next, *flush_prev;
+	int flush_queued;
+
+	// Zero-copy relay (-z): payload moves socket -> pipe -> socket
+	int pipe_fd[2];			// borrowed from the worker's pool, -1 when none
+	size_t splice_in;		// payload bytes still to move into the pipe
+	size_t in_pipe;			// bytes sitting in the pipe
+	size_t spliced;			// payload bytes relayed without a copy
+	unsigned char hdr[FRAME_HDRLEN];	// header being read in zero-copy mode
+	int hlen;
+
+	// Latency: replies queued since the last time the output drained
+	uint64_t last_read;		// when the latest input arrived (ns)
+
+	// Handshake timeout until the first frame, idle timeout after it
+	struct Timer timer;
+	uint64_t pending_since;		// arrival of the oldest unsent reply's request
+	uint64_t pending_msgs;
+};
+
+// Per-worker state: each worker owns a listener, an epoll instance and its
+// connection table, so workers never share a cache line on the hot path.
+struct Worker
+{
+	pthread_t thread;
+	int id;
+	int cpu;			// CPU the worker is pinned to (-c), -1 when not
+	int fd_server;
+	struct EvLoop *loop;
+
+	struct Pool conns;		// Connection structs of this worker
+	char *scratch;			// READ_CHUNK bytes every read lands in first
+	int accept_pending;		// listener backlog not yet drained
+
+	// Connection timeouts; the timerfd ticks the wheel every TICK_MS
+	struct Wheel wheel;
+	int timer_fd;
+	int timer_pending;		// a tick arrived, expire after the pass
+
+	// Written by the stop signal so the loop sees stopping; its loop
+	// entry carries &wake_fd
+	int wake_fd;
+
+	uint64_t rusage_at;		// TscNow of the last MetricsRusage
+
+	// Busy-poll (-p): spinning lasts busy_poll past busy_at
+	uint64_t busy_at;		// last wait that returned events (ns)
+	int pauses;			// spin-wait hints after the next empty poll
+
+	// Admission control: this worker's share of the connection limit
+	size_t max_conns;
+	size_t resume_conns;
+	int accept_paused;		// listener ignored until resume_conns
+	int spare_fd;			// given up on EMFILE to accept and reject
+	uint64_t retry_at;		// resume time of a pause for want of descriptors
+	struct Connection *flush_list;	// replies to send at the end of the pass
+
+	// UDP echo (-u): a datagram socket and udp_batch receive slots, which
+	// the replies are sent from; its loop entry carries &udp_fd
+	int udp_fd;
+	struct mmsghdr *udp_msgs;
+	struct iovec *udp_iov;
+	struct sockaddr_storage *udp_addr;
+	char *udp_buf;
+
+	// Idle relay pipes, reused across connections
+	int (*pipes)[2];
+	int num_pipes;
+
+	struct Metrics m __attribute__ ((aligned (CACHE_LINE)));
+} __attribute__ ((aligned (CACHE_LINE)));
+
+// ClearSocket/FlushSocket results
+#define CONN_OPEN	1
+#define CONN_DONE	0
+
+#define ACCEPT_BATCH	64		// default cap on accepts per loop iteration
 
 //Globals
-int fd_server;
+struct Worker *workers;
+int num_workers = 1;
+int accept_batch = ACCEPT_BATCH;
+int zero_copy = FALSE;
+int stats_port = 0;
+int backend = EV_EPOLL_ET;
+uint64_t flush_delay = 0;	// ns a reply may wait for others to share its write
+int cork = FALSE;
+uint64_t handshake_timeout = HANDSHAKE_TIMEOUT * 1000000000ULL;
+uint64_t idle_timeout = IDLE_TIMEOUT * 1000000000ULL;
+const char *log_path = LOG_FILE;
+struct ConnLog *conn_log;
+uint32_t num_clients = 0;	// clients accepted by all workers
+size_t max_conns = 0;		// -m, 0 for what RLIMIT_NOFILE allows
+int udp_batch = 0;		// -u, datagrams per system call, 0 for no UDP
+const char *unix_path = NULL;	// Unix-domain endpoint in place of the port
+int cpus[MAX_WORKERS];		// -c, CPUs the workers are pinned to in turn
+int num_cpus = 0;
+uint64_t busy_poll = 0;		// -p, ns the loop polls after its last event
+int busy_warned = FALSE;		// one warning for all workers
+volatile sig_atomic_t stopping = FALSE;	// set by SIGINT and SIGTERM
+
+// Spin-wait hint between busy polls: yields the core's pipeline to a
+// sibling hyperthread and saves power
+static inline void CpuRelax (void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+	__builtin_ia32_pause ();
+#elif defined (__aarch64__)
+	__asm__ __volatile__ ("yield" ::: "memory");
+#else
+	__asm__ __volatile__ ("" ::: "memory");
+#endif
+}
 
 // Function prototypes
 static void SystemFatal (const char* message);
-static int ClearSocket (int fd);
-void close_fd (int);
-
-pthread_mutex_t tlock = PTHREAD_MUTEX_INITIALIZER;
-
-// Logging
-clock_t start;
-int requests_log[EPOLL_QUEUE_LEN] = {0};
-int client_port[EPOLL_QUEUE_LEN];
-unsigned long client_ip[EPOLL_QUEUE_LEN];
+static int CreateListener (int port);
+static int CreateDatagramSocket (int port);
+static int ParseCpuList (const char *list, int *cpus, int max);
+static void SteerByCpu (int fd);
+static void EchoDatagrams (struct Worker *w);
+static void *WorkerLoop (void *arg);
+static void AcceptClients (struct Worker *w);
+static struct Connection *NewConnection (struct Worker *w, int fd, struct sockaddr_in *addr);
+static void CloseConnection (struct Worker *w, struct Connection *c);
+static int ReadSocket (struct Worker *w, struct Connection *c);
+static int ClearSocket (struct Worker *w, struct Connection *c);
+static int FlushSocket (struct Worker *w, struct Connection *c);
+static long FlushPending (struct Worker *w);
+static void ArmTimer (struct Worker *w, struct Connection *c);
+static void ExpireConnections (struct Worker *w);
+static void PauseAccept (struct Worker *w);
+static void ResumeAccept (struct Worker *w);
+static int SpliceSocket (struct Worker *w, struct Connection *c);
+static void UpdateInterest (struct Worker *w, struct Connection *c);
+static void ConsumeOutput (struct Connection *c, size_t n);
+static void UnqueueFlush (struct Worker *w, struct Connection *c);
+static int GetPipe (struct Worker *w, struct Connection *c);
+static void PutPipe (struct Worker *w, struct Connection *c);
+static void Stop (int signo);
 
 int main (int argc, char* argv[])
 {
-	int i, arg;
-	int num_fds, fd_new, epoll_fd;
+	int i, opt, fd_unix = -1, threads_set = FALSE;
 	int port = SERVER_PORT;
-	int requests = 0;
-
-	static struct epoll_event events[EPOLL_QUEUE_LEN], event, emptyEvent;
-	struct sockaddr_in addr, remote_addr;
+	pthread_attr_t attr;
+	cpu_set_t set;
 	struct sigaction act;
+	struct rlimit rl;
+	struct Metrics **metrics;
+
+	while ((opt = getopt (argc, argv, "t:a:zs:b:F:Ch:i:l:m:u:c:p:")) != -1)
+	{
+		switch (opt)
+		{
+			case 't':
+				// -t 0 starts one worker per online core
+				num_workers = atoi (optarg);
+				if (num_workers == 0)
+					num_workers = sysconf (_SC_NPROCESSORS_ONLN);
+				threads_set = TRUE;
+				break;
+			case 'c':
+				if ((num_cpus = ParseCpuList (optarg, cpus, MAX_WORKERS)) <= 0)
+				{
+					fprintf (stderr, "CPU list must be like 0-3,8 and name at most %d CPUs\n", MAX_WORKERS);
+					exit (EXIT_FAILURE);
+				}
+				break;
+			case 'a':
+				// -a 0 drains the whole backlog on every wakeup
+				accept_batch = atoi (optarg);
+				break;
+			case 'z':
+				zero_copy = TRUE;
+				break;
+			case 's':
+				stats_port = atoi (optarg);
+				break;
+			case 'F':
+				// -F usec holds replies up to usec for company
+				flush_delay = strtoull (optarg, NULL, 10) * 1000;
+				break;
+			case 'C':
+				cork = TRUE;
+				break;
+			case 'p':
+				busy_poll = strtoull (optarg, NULL, 10) * 1000;
+				break;
+			case 'h':
+				// -h 0 and -i 0 turn the timeouts off
+				handshake_timeout = strtoull (optarg, NULL, 10) * 1000000000ULL;
+				break;
+			case 'i':
+				idle_timeout = strtoull (optarg, NULL, 10) * 1000000000ULL;
+				break;
+			case 'l':
+				log_path = optarg;
+				break;
+			case 'm':
+				max_conns = strtoul (optarg, NULL, 10);
+				break;
+			case 'u':
+				udp_batch = atoi (optarg);
+				if (udp_batch < 1 || udp_batch > UDP_BATCH_MAX)
+				{
+					fprintf (stderr, "UDP batch must be between 1 and %d\n", UDP_BATCH_MAX);
+					exit (EXIT_FAILURE);
+				}
+				break;
+			case 'b':
+				if ((backend = EvBackendByName (optarg)) == -1)
+				{
+					fprintf (stderr, "Backend must be select, poll, epoll-lt or epoll-et\n");
+					exit (EXIT_FAILURE);
+				}
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-t threads] [-c cpu list] [-a accept batch] [-b backend] [-F flush usec] [-C] [-p busy-poll usec] [-h handshake secs] [-i idle secs] [-l log file] [-m max connections] [-u udp batch] [-z] [-s stats port] [port | socket path]\n", argv[0]);
+				exit (EXIT_FAILURE);
+		}
+	}
+	if (optind < argc)
+	{
+		if (EndpointIsPath (argv[optind]))
+			unix_path = argv[optind];
+		else
+			port = atoi (argv[optind]);
+	}
+	if (unix_path && (udp_batch || cork))
+	{
+		fprintf (stderr, "-u and -C need a TCP port\n");
+		exit (EXIT_FAILURE);
+	}
+	if (num_cpus && !threads_set)
+		num_workers = num_cpus;
+	if (accept_batch < 0)
+	{
+		fprintf (stderr, "Accept batch must not be negative\n");
+		exit (EXIT_FAILURE);
+	}
+	if (num_workers < 1 || num_workers > MAX_WORKERS)
+	{
+		fprintf (stderr, "Number of threads must be between 1 and %d\n", MAX_WORKERS);
+		exit (EXIT_FAILURE);
+	}
 
-    pthread_t threadList[EPOLL_QUEUE_LEN];
-	socklen_t addr_size = sizeof(struct sockaddr_in);
+	// splice has no MSG_NOSIGNAL: a client resetting mid-relay raises SIGPIPE
+	signal (SIGPIPE, SIG_IGN);
 
+	// Take every descriptor we may and cap connections below that, so the
+	// limit normally pauses accepting before accept4 can fail with EMFILE
+	if (getrlimit (RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit (RLIMIT_NOFILE, &rl);
+	}
+	if (max_conns == 0)
+	{
+		getrlimit (RLIMIT_NOFILE, &rl);
+		max_conns = rl.rlim_cur > FD_RESERVE * 2 ? rl.rlim_cur - FD_RESERVE : FD_RESERVE;
+		if (backend == EV_SELECT && max_conns > FD_SETSIZE - FD_RESERVE)
+			max_conns = FD_SETSIZE - FD_RESERVE;
+	}
 
-	// set up the signal handler to close the server socket when CTRL-c is received
-        act.sa_handler = close_fd;
-        act.sa_flags = 0;
-        if ((sigemptyset (&act.sa_mask) == -1 || sigaction (SIGINT, &act, NULL) == -1))
-        {
-                perror ("Failed to set SIGINT handler");
-                exit (EXIT_FAILURE);
-        }
+	if (posix_memalign ((void **) &workers, CACHE_LINE, num_workers * sizeof (struct Worker)) != 0)
+		SystemFatal ("posix_memalign");
+	memset (workers, 0, num_workers * sizeof (struct Worker));
+
+	// Every worker binds its own listener to the same port; the kernel
+	// load-balances new connections across them. A Unix-domain listener
+	// is shared instead.
+	if (unix_path && (fd_unix = EndpointListenUnix (unix_path, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1)
+		SystemFatal (unix_path);
+	if ((metrics = calloc (num_workers, sizeof (struct Metrics *))) == NULL)
+		SystemFatal ("calloc");
+	for (i = 0; i < num_workers; i++)
+	{
+		workers[i].id = i;
+		workers[i].cpu = num_cpus ? cpus[i % num_cpus] : -1;
+		workers[i].fd_server = unix_path ? fd_unix : CreateListener (port);
+		workers[i].udp_fd = udp_batch ? CreateDatagramSocket (port) : -1;
+
+		// SO_REUSEPORT spreads connections evenly, so is the limit
+		workers[i].max_conns = (max_conns + num_workers - 1) / num_workers;
+		workers[i].resume_conns = workers[i].max_conns * RESUME_PCT / 100;
+		if ((workers[i].spare_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC)) == -1)
+			SystemFatal ("open /dev/null");
+		if ((workers[i].wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+			SystemFatal ("eventfd");
+		MetricsInit (&workers[i].m);
+		metrics[i] = &workers[i].m;
+	}
+
+	// Serve each connection on the worker pinned to the CPU its packets
+	// arrive on
+	if (num_cpus && !unix_path)
+	{
+		SteerByCpu (workers[0].fd_server);
+		if (udp_batch)
+			SteerByCpu (workers[0].udp_fd);
+	}
+
+	// Connection service time is taken from the TSC
+	TscInit ();
+
+	// Per-connection summaries go to a binary log, written by its own thread
+	if ((conn_log = ConnLogOpen (log_path, num_workers)) == NULL)
+		SystemFatal (log_path);
+
+	// Live counters on request, e.g. nc localhost <stats port>
+	if (stats_port && MetricsStartServer (stats_port, metrics, num_workers) == -1)
+		SystemFatal ("stats listener");
+
+	// CTRL-c, or a plain kill, stops the workers; the log is drained once
+	// they have returned
+	memset (&act, 0, sizeof (act));
+	act.sa_handler = Stop;
+	if (sigemptyset (&act.sa_mask) == -1 || sigaction (SIGINT, &act, NULL) == -1
+		|| sigaction (SIGTERM, &act, NULL) == -1)
+		SystemFatal ("sigaction");
+
+	for (i = 0; i < num_workers; i++)
+	{
+		// A pinned worker starts on its CPU, so its first touch of the
+		// memory it allocates places it on the local node
+		pthread_attr_init (&attr);
+		if (workers[i].cpu >= 0)
+		{
+			CPU_ZERO (&set);
+			CPU_SET (workers[i].cpu, &set);
+			pthread_attr_setaffinity_np (&attr, sizeof (set), &set);
+		}
+		if ((errno = pthread_create (&workers[i].thread, &attr, WorkerLoop, &workers[i])) != 0)
+			SystemFatal ("pthread_create");
+		pthread_attr_destroy (&attr);
+	}
+
+	for (i = 0; i < num_workers; i++)
+		pthread_join (workers[i].thread, NULL);
+
+	ConnLogClose (conn_log);
+	if (unix_path)
+	{
+		close (fd_unix);
+		unlink (unix_path);
+	}
+	exit (EXIT_SUCCESS);
+}
+
+// Creates a non-blocking listening socket bound to port with SO_REUSEPORT.
+static int CreateListener (int port)
+{
+	int fd, arg;
+	struct sockaddr_in addr;
 
 	// Create the listening socket
-	fd_server = socket (AF_INET, SOCK_STREAM, 0);
-    	if (fd_server == -1)
+	fd = socket (AF_INET, SOCK_STREAM, 0);
+    	if (fd == -1)
 		SystemFatal("socket");
 
     	// set SO_REUSEADDR so port can be resused imemediately after exit, i.e., after CTRL-c
     	arg = 1;
-    	if (setsockopt (fd_server, SOL_SOCKET, SO_REUSEADDR, &arg, sizeof(arg)) == -1)
+    	if (setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &arg, sizeof(arg)) == -1)
+		SystemFatal("setsockopt");
+
+	// set SO_REUSEPORT so every worker can bind a listener to the same port
+    	if (setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &arg, sizeof(arg)) == -1)
 		SystemFatal("setsockopt");
 
     	// Make the server listening socket non-blocking
-    	if (fcntl (fd_server, F_SETFL, O_NONBLOCK | fcntl (fd_server, F_GETFL, 0)) == -1)
+    	if (fcntl (fd, F_SETFL, O_NONBLOCK | fcntl (fd, F_GETFL, 0)) == -1)
 		SystemFatal("fcntl");
 
     	// Bind to the specified listening port
@@ -107,185 +516,1243 @@ int main (int argc, char* argv[])
     	addr.sin_family = AF_INET;
     	addr.sin_addr.s_addr = htonl(INADDR_ANY);
     	addr.sin_port = htons(port);
-    	if (bind (fd_server, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+    	if (bind (fd, (struct sockaddr*) &addr, sizeof(addr)) == -1)
 		SystemFatal("bind");
 
+	// Busy-poll the device queue on reads (-p); accepted sockets inherit
+	// it. Raising it past net.core.busy_read takes CAP_NET_ADMIN.
+	arg = busy_poll / 1000;
+	if (busy_poll && setsockopt (fd, SOL_SOCKET, SO_BUSY_POLL, &arg, sizeof (arg)) == -1 && errno != EPERM)
+		perror ("setsockopt SO_BUSY_POLL");
+
     	// Listen for fd_news; SOMAXCONN is 128 by default
-    	if (listen (fd_server, SOMAXCONN) == -1)
+    	if (listen (fd, SOMAXCONN) == -1)
 		SystemFatal("listen");
 
-    	// Create the epoll file descriptor
-    	epoll_fd = epoll_create(EPOLL_QUEUE_LEN);
-    	if (epoll_fd == -1)
-		SystemFatal("epoll_create");
-
-    	// Add the server socket to the epoll event loop
-    	event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
-    	event.data.fd = fd_server;
-    	if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd_server, &event) == -1)
-		SystemFatal("epoll_ctl");
-	int z = 0;
-	int firstRun = 0;
-	int modified = 0;
-	// Execute the epoll event loop
-	while (TRUE)
-	{
-		// printf("Starting iteration: %d\n", z);
-		// printf("Waiting epoll now\n");
-		//struct epoll_event events[MAX_EVENTS];
+	return fd;
+}
+
+// Creates a non-blocking UDP socket bound to port with SO_REUSEPORT.
+static int CreateDatagramSocket (int port)
+{
+	int fd, arg = 1;
+	struct sockaddr_in addr;
+
+	if ((fd = socket (AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+		SystemFatal ("socket");
+	if (setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &arg, sizeof (arg)) == -1)
+		SystemFatal ("setsockopt");
+
+	// Room for bursts between wakeups; the kernel caps it silently
+	arg = UDP_RCVBUF;
+	setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &arg, sizeof (arg));
+
+	memset (&addr, 0, sizeof (struct sockaddr_in));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_ANY);
+	addr.sin_port = htons (port);
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) == -1)
+		SystemFatal ("bind");
+	return fd;
+}
+
+// Parses a CPU list such as "0-3,8" into cpus. Returns the number of CPUs,
+// or -1 if the list is malformed or names more than max.
+static int ParseCpuList (const char *list, int *cpus, int max)
+{
+	char *end;
+	long lo, hi;
+	int n = 0;
 
-		//first run
-		if (firstRun == 0)
+	while (*list != '\0')
+	{
+		lo = hi = strtol (list, &end, 10);
+		if (end == list || lo < 0 || lo >= CPU_SETSIZE)
+			return -1;
+		if (*end == '-')
 		{
-			num_fds = epoll_wait (epoll_fd, events, EPOLL_QUEUE_LEN, -1);
+			list = end + 1;
+			hi = strtol (list, &end, 10);
+			if (end == list || hi < lo || hi >= CPU_SETSIZE)
+				return -1;
 		}
-		else
+		for (; lo <= hi; lo++)
 		{
-			//runs after the first connection
-			num_fds = epoll_wait (epoll_fd, events, EPOLL_QUEUE_LEN, 1000);
+			if (n == max)
+				return -1;
+			cpus[n++] = lo;
 		}
-		// printf("%d\n", num_fds);
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		list = end;
+	}
+	return n;
+}
+
+// Attaches a classic BPF program to the reuseport group of fd that picks
+// the socket of the first worker pinned to the current CPU, i.e. the one
+// processing the packet. Sockets joined the group in worker order, so the
+// worker's index is the socket's; an index past the group (other CPUs)
+// leaves the choice to the kernel's hash. CloseConnection counts the
+// connections served elsewhere than their packets' CPU as offcpu_conns.
+static void SteerByCpu (int fd)
+{
+	struct sock_filter code[2 * MAX_WORKERS + 2];
+	struct sock_fprog prog;
+	int i, n = 0;
+
+	code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+	for (i = 0; i < num_workers; i++)
+	{
+		code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, workers[i].cpu, 0, 1);
+		code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K, i);
+	}
+	code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K, 0xffffffff);
+
+	prog.len = n;
+	prog.filter = code;
+	if (setsockopt (fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof (prog)) == -1)
+		perror ("SO_ATTACH_REUSEPORT_CBPF, connections are hashed to workers");
+}
+
+// The event loop run by every worker thread.
+static void *WorkerLoop (void *arg)
+{
+	struct Worker *w = arg;
+	int i, k;
+	int num_fds, state, busy, ticks;
+	long timeout = -1, wait;
+	uint64_t now, start, rusage_ticks = RUSAGE_MS * 1e6 / tsc_ns_per_tick;
+	int fd_server = w->fd_server;
+	struct Connection *c;
+	struct EvEvent *events;
+
+	// Allocate the connection table from the worker thread itself
+	PoolInit (&w->conns, sizeof (struct Connection));
+	w->scratch = malloc (READ_CHUNK);
+	w->pipes = calloc (PIPE_POOL_MAX, sizeof (*w->pipes));
+	events = calloc (MAX_EVENTS, sizeof (struct EvEvent));
+	if (w->scratch == NULL || w->pipes == NULL || events == NULL)
+		SystemFatal ("calloc");
 
-		//If epoll timed out, change edge trigger to level trigger to flush out missed items. Reset at the end.
-		if(num_fds == 0)
+    	// Create the event loop (an epoll instance by default)
+	if ((w->loop = EvCreate (backend, MAX_EVENTS)) == NULL)
+		SystemFatal("EvCreate");
+
+    	// Add the server socket to the event loop
+	// the listener is the only entry without a Connection
+    	if (EvAdd (w->loop, fd_server, EV_READ, NULL) == -1)
+		SystemFatal("EvAdd");
+
+	// Tick the timer wheel from a timerfd in the same loop; its entry
+	// carries the wheel's address
+	w->timer_fd = -1;
+	if (handshake_timeout || idle_timeout)
+	{
+		struct itimerspec tick = { { 0, TICK_MS * 1000000L }, { 0, TICK_MS * 1000000L } };
+
+		WheelInit (&w->wheel, TICK_MS * 1000000ULL, MetricsNow ());
+		if ((w->timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+			SystemFatal("timerfd_create");
+		if (timerfd_settime (w->timer_fd, 0, &tick, NULL) == -1)
+			SystemFatal("timerfd_settime");
+		if (EvAdd (w->loop, w->timer_fd, EV_READ, &w->wheel) == -1)
+			SystemFatal("EvAdd");
+	}
+	if (EvAdd (w->loop, w->wake_fd, EV_READ, &w->wake_fd) == -1)
+		SystemFatal("EvAdd");
+
+	// Each receive slot is a buffer and an address; replies reuse both
+	if (w->udp_fd != -1)
+	{
+		w->udp_msgs = calloc (udp_batch, sizeof (struct mmsghdr));
+		w->udp_iov = calloc (udp_batch, sizeof (struct iovec));
+		w->udp_addr = calloc (udp_batch, sizeof (struct sockaddr_storage));
+		w->udp_buf = malloc ((size_t) udp_batch * UDP_MAXLEN);
+		if (w->udp_msgs == NULL || w->udp_iov == NULL || w->udp_addr == NULL || w->udp_buf == NULL)
+			SystemFatal ("calloc");
+		for (i = 0; i < udp_batch; i++)
+		{
+			w->udp_iov[i].iov_base = w->udp_buf + (size_t) i * UDP_MAXLEN;
+			w->udp_msgs[i].msg_hdr.msg_iov = &w->udp_iov[i];
+			w->udp_msgs[i].msg_hdr.msg_iovlen = 1;
+			w->udp_msgs[i].msg_hdr.msg_name = &w->udp_addr[i];
+		}
+		if (EvAdd (w->loop, w->udp_fd, EV_READ, &w->udp_fd) == -1)
+			SystemFatal("EvAdd");
+	}
+
+	// Busy-poll (-p): until busy_poll ns have passed since a wait last
+	// returned events, the loop polls with a zero timeout, pausing twice as
+	// long after each empty poll up to BUSY_PAUSE_MAX, then blocks again.
+	// Where the kernel (6.9 or later) and the device can, the epoll
+	// instance busy-polls the device queues for us as well; loopback has
+	// none. The stats port counts empty_polls.
+	w->pauses = 1;
+	if (busy_poll && EvBusyPoll (w->loop, busy_poll / 1000) == -1
+		&& !__atomic_exchange_n (&busy_warned, TRUE, __ATOMIC_RELAXED))
+		perror ("EvBusyPoll: spinning in user space only");
+	// Execute the epoll event loop
+	while (!stopping)
+	{
+		// Don't block while the listener still has a backlog to drain,
+		// nor past the time a held reply is due, nor while busy-polling
+		wait = w->accept_pending ? 0 : timeout;
+		busy = FALSE;
+		if (busy_poll && wait != 0 && MetricsNow () - w->busy_at < busy_poll)
 		{
-			printf("Timed out!!!\n");
-			event.events = EPOLLIN | EPOLLERR | EPOLLHUP;
-			event.data.fd = fd_server;
-			epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd_server, &event);
-			modified = 1;
+			wait = 0;
+			busy = TRUE;
 		}
+		num_fds = EvWait (w->loop, events, MAX_EVENTS, wait);
+		METRIC_ADD (&w->m, syscalls, 1);
 
 		if (num_fds < 0)
 		{
-			SystemFatal ("Error in epoll_wait!");
-			break;
+			if (errno == EINTR)
+				continue;
+			SystemFatal ("Error in EvWait!");
+		}
+
+		// Spinning goes on while there is traffic (timer ticks aside)
+		// and slows down the longer the polls come back empty
+		if (busy_poll)
+		{
+			ticks = w->timer_fd != -1 && num_fds == 1 && events[0].ptr == &w->wheel;
+			if (num_fds > ticks)
+			{
+				w->busy_at = MetricsNow ();
+				w->pauses = 1;
+			}
+			else if (busy)
+			{
+				METRIC_ADD (&w->m, empty_polls, 1);
+				for (k = 0; k < w->pauses; k++)
+					CpuRelax ();
+				if (w->pauses < BUSY_PAUSE_MAX)
+					w->pauses *= 2;
+			}
 		}
 
 		for (i = 0; i < num_fds; i++)
 		{
+			c = events[i].ptr;
+
+			// Timer tick; connections are expired once the pass is over
+			if (events[i].ptr == &w->wheel)
+			{
+				w->timer_pending = TRUE;
+				continue;
+			}
+
+			// Stop signal; the loop condition ends the loop
+			if (events[i].ptr == &w->wake_fd)
+				continue;
+
+			// Datagrams are echoed as soon as they are read
+			if (events[i].ptr == &w->udp_fd)
+			{
+				EchoDatagrams(w);
+				continue;
+			}
+
 	    		// Case: Hang up condition Error condition
-	    		if (events[i].events & (EPOLLHUP | EPOLLERR))
+	    		if (events[i].events & EV_ERROR)
 				{
-					fputs("epoll: EPOLLHUP | EPOLLERR\n", stderr);
-					// send ((events[i].data.fd), "There was a HangUp, goodbye", BUFLEN, 0);
-					close(events[i].data.fd);
-					//clear the data when finished processesing;
-					events[i] = emptyEvent;
+					// Counted, not printed: the loop never waits on stdio
+					if (c != NULL)
+					{
+						METRIC_ADD (&w->m, hangups, 1);
+						CloseConnection(w, c);
+					}
+					// The listener may be shared by every worker (a Unix
+					// path), so it stays open; accept4 reports the error
+					else if (!w->accept_paused)
+						w->accept_pending = TRUE;
 					continue;
 	    		}
 
-	    		// Case 2: Server is receiving a connection request
-	    		if (events[i].data.fd == fd_server)
+	    		// Case 2: Server is receiving connection requests; they are
+	    		// accepted after the established connections have been served
+	    		if (c == NULL)
 				{
-					//socklen_t addr_size = sizeof(remote_addr);
-					fd_new = accept (fd_server, (struct sockaddr*) &remote_addr, &addr_size);
+					if (!w->accept_paused)
+						w->accept_pending = TRUE;
+					continue;
+	    		}
+				state = CONN_OPEN;
+				start = TscNow();
 
-					if (fd_new == -1)
-					{
-			    			if (errno != EAGAIN && errno != EWOULDBLOCK)
-						{
-							perror("accept");
-			    			}
-			    			continue;
-					}
+				// The relay pumps both directions on any readiness change
+				if (zero_copy)
+					state = SpliceSocket(w, c);
+
+				// Drain replies the socket refused first; this may unblock
+				// reading. Others wait for the flush at the end of the pass.
+				else if ((events[i].events & EV_WRITE) && c->write_blocked)
+				{
+					state = FlushSocket(w, c);
+					if (state == CONN_OPEN && c->read_blocked && c->wqueued == 0)
+						state = ClearSocket(w, c);
+				}
+				if (!zero_copy && state == CONN_OPEN && (events[i].events & EV_READ))
+					state = ClearSocket(w, c);
+				if (state == CONN_OPEN)
+					UpdateInterest(w, c);
+				c->active += TscNow() - start;
+
+				if (state == CONN_DONE)
+				{
+					//Clean fd removal
+					CloseConnection(w, c);
+				}
+			}
 
-					// Make the fd_new non-blocking
-					if (fcntl (fd_new, F_SETFL, O_NONBLOCK | fcntl(fd_new, F_GETFL, 0)) == -1)
-						SystemFatal("fcntl");
+			if (w->accept_pending)
+				AcceptClients(w);
+			if (w->timer_pending)
+				ExpireConnections(w);
 
-					// Add the new socket descriptor to the epoll loop
-    				event.events = EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET | EPOLLEXCLUSIVE;
-					event.data.fd = fd_new;
-					if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd_new, &event) == -1)
-						SystemFatal ("epoll_ctl");
+			// One write per connection for everything it produced in the pass
+			timeout = FlushPending(w);
 
-					// Logging requests
-					requests_log[fd_new]++;
+			// Retry a listener paused for want of descriptors
+			if (w->retry_at)
+			{
+				now = MetricsNow();
+				if (now >= w->retry_at)
+					ResumeAccept(w);
+				else if (timeout == -1 || (uint64_t) timeout > (w->retry_at - now) / 1000)
+					timeout = (w->retry_at - now + 999) / 1000;
+			}
+
+			// Publish this thread's CPU time, at most RUSAGE_MS stale
+			start = TscNow();
+			if (start - w->rusage_at >= rusage_ticks)
+			{
+				MetricsRusage(&w->m);
+				w->rusage_at = start;
+			}
+    	}
 
-					client_ip[fd_new] = inet_ntoa(remote_addr.sin_addr);
-					client_port[fd_new] = ntohs(remote_addr.sin_port);
+	// Stopped. A Unix listener is shared by every worker and left to main;
+	// connections still open go with the process.
+	if (!unix_path)
+		close(fd_server);
+	if (w->timer_fd != -1)
+		close(w->timer_fd);
+	if (w->udp_fd != -1)
+		close(w->udp_fd);
+	while (w->num_pipes > 0)
+	{
+		w->num_pipes--;
+		close(w->pipes[w->num_pipes][0]);
+		close(w->pipes[w->num_pipes][1]);
+	}
+	EvDestroy(w->loop);
+	free(w->udp_msgs);
+	free(w->udp_iov);
+	free(w->udp_addr);
+	free(w->udp_buf);
+	free(w->pipes);
+	free(w->scratch);
+	free(events);
+	return NULL;
+}
 
-					// printf(" Remote Address:  %s\n", inet_ntoa(remote_addr.sin_addr));
-					//clear the data when finished processesing;
-					events[i] = emptyEvent;
-					continue;
-	    		}
-				// pthread_create(&threadList[i], NULL, CheckSocket, events[i].data.fd);
-				// pthread_join(threadList[i]);
-				// printf("Split!");
-				if(events[i].events & (EPOLLIN && EPOLLOUT))
+// Accepts up to accept_batch queued connections (all of them if it is 0).
+// In edge-triggered mode the listener only signals again for new arrivals,
+// so accept_pending stays set until accept4 reports an empty backlog.
+// Admission control: a worker at its share of -m stops accepting until its
+// connections fall to RESUME_PCT of it. If accept4 fails for want of
+// descriptors anyway, the spare one is given up to accept and reject the
+// connection; without it accepting pauses for ACCEPT_RETRY_MS.
+static void AcceptClients (struct Worker *w)
+{
+	int n, fd_new;
+	struct Connection *c;
+	struct sockaddr_in remote_addr;
+	socklen_t addr_size;
+
+	for (n = 0; accept_batch == 0 || n < accept_batch; n++)
+	{
+		// At the limit, leave new connections in the backlog
+		if (w->conns.live >= w->max_conns)
+		{
+			PauseAccept (w);
+			return;
+		}
+
+		addr_size = sizeof(struct sockaddr_in);
+		fd_new = accept4 (w->fd_server, (struct sockaddr*) &remote_addr, &addr_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		METRIC_ADD (&w->m, syscalls, 1);
+		if (fd_new == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			// Out of descriptors: the listener stays readable, so take
+			// the connection with the spare descriptor and close it
+			// rather than spin on the error
+			if ((errno == EMFILE || errno == ENFILE) && w->spare_fd != -1)
+			{
+				close (w->spare_fd);
+				fd_new = accept4 (w->fd_server, NULL, NULL, SOCK_CLOEXEC);
+				if (fd_new != -1)
 				{
-					if (!ClearSocket(events[i].data.fd))
-						{
-							// epoll will remove the fd from its set
-							// automatically when the fd is closed
-
-							//Clean fd removal
-							epoll_ctl(epoll_fd, EPOLL_CTL_DEL, events[i].data.fd, NULL);
-							close (events[i].data.fd);
-							//clear the data when finished processesing;
-							events[i] = emptyEvent;
-						}
+					close (fd_new);
+					METRIC_ADD (&w->m, rejected, 1);
 				}
-				// printf("Iteration: %d completed\n", z);
-				z += 1;
+				w->spare_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+				METRIC_ADD (&w->m, syscalls, 3);
+				if (fd_new != -1)
+					continue;
 			}
-			firstRun = -1;
+			if (errno == EMFILE || errno == ENFILE)
+			{
+				// Not even the spare: try again in a while
+				PauseAccept (w);
+				w->retry_at = MetricsNow () + ACCEPT_RETRY_MS * 1000000ULL;
+				return;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept");
+			w->accept_pending = FALSE;
+			return;
+		}
 
-			// Reset epoll's Trigger
-			if(modified = 1)
+		// Add the new socket descriptor to the event loop; when
+		// edge-triggered, EPOLLOUT stays armed so queued replies are
+		// flushed on the next edge
+		c = NewConnection(w, fd_new, &remote_addr);
+		c->interest = EV_READ;
+		if (EvAdd (w->loop, fd_new, c->interest, c) == -1)
+		{
+			// select can't take descriptors past FD_SETSIZE
+			close (fd_new);
+			PoolFree (&w->conns, c);
+			METRIC_ADD (&w->m, rejected, 1);
+			continue;
+		}
+		if (backend >= EV_EPOLL_LT)
+			METRIC_ADD (&w->m, syscalls, 1);
+		METRIC_ADD (&w->m, accepts, 1);
+		c->number = __atomic_add_fetch (&num_clients, 1, __ATOMIC_RELAXED);
+		c->accepted_at = c->last_read = MetricsNow ();
+		ArmTimer (w, c);
+	}
+
+	// Batch cap reached; keep draining on the next pass
+	w->accept_pending = TRUE;
+}
+
+// Allocates the state for a newly accepted client.
+static struct Connection *NewConnection (struct Worker *w, int fd, struct sockaddr_in *addr)
+{
+	struct Connection *c;
+
+	if ((c = PoolAlloc (&w->conns)) == NULL)
+		SystemFatal ("PoolAlloc");
+	c->pipe_fd[0] = c->pipe_fd[1] = -1;
+	c->fd = fd;
+	c->ip.s_addr = 0;
+	c->port = 0;
+	if (addr->sin_family == AF_INET)	// Unix-domain peers have no address
+	{
+		c->ip = addr->sin_addr;
+		c->port = ntohs (addr->sin_port);
+	}
+	return c;
+}
+
+// Logs the client's summary, removes it from the loop and frees its state.
+// The record holds the connection's lifetime on the monotonic clock and
+// the time spent serving it, timed with the TSC (logcsv -x prints it).
+static void CloseConnection (struct Worker *w, struct Connection *c)
+{
+	struct ConnRecord r;
+	socklen_t len = sizeof (int);
+	int cpu;
+
+	// Request logging, written out by the log thread
+	r.number = c->number;
+	r.ip = c->ip.s_addr;
+	r.port = c->port;
+	r.thread = w->id;
+	r.requests = c->requests;
+	r.secs = (MetricsNow () - c->accepted_at) / 1e9;
+	r.active_secs = TscToNs (c->active) / 1e9;
+	r.bytes = c->bytes;
+	r.spliced = c->spliced;
+	if (ConnLogPut (conn_log, w->id, &r) == -1)
+		METRIC_ADD (&w->m, log_drops, 1);
+	if (c->pipe_fd[0] != -1)
+		PutPipe (w, c);
+	WheelCancel (&w->wheel, &c->timer);
+
+	// Was it served on the CPU its packets arrived on?
+	if (w->cpu >= 0 && !unix_path)
+	{
+		if (getsockopt (c->fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0 && cpu >= 0 && cpu != w->cpu)
+			METRIC_ADD (&w->m, offcpu_conns, 1);
+		METRIC_ADD (&w->m, syscalls, 1);
+	}
+
+	// epoll would drop the fd on close, but only once every reference is gone
+	EvDel (w->loop, c->fd);
+	close (c->fd);
+	METRIC_ADD (&w->m, syscalls, backend >= EV_EPOLL_LT ? 2 : 1);
+	METRIC_ADD (&w->m, closes, 1);
+	free (c->rbuf);
+	UnqueueFlush (w, c);
+	ConsumeOutput (c, c->wqueued);
+	free (c->whead);
+	PoolFree (&w->conns, c);
+
+	if (w->accept_paused && !w->retry_at && w->conns.live <= w->resume_conns)
+		ResumeAccept (w);
+}
+
+// Stops watching the listener. New connections queue in its backlog (and
+// past that, the kernel drops their SYNs and the clients retry) until
+// ResumeAccept; a level-triggered loop would otherwise report it forever.
+static void PauseAccept (struct Worker *w)
+{
+	w->accept_pending = FALSE;
+	if (w->accept_paused)
+		return;
+	w->accept_paused = TRUE;
+	if (EvMod (w->loop, w->fd_server, 0, NULL) == -1)
+		SystemFatal ("EvMod");
+	METRIC_ADD (&w->m, accept_pauses, 1);
+}
+
+// Watches the listener again once connections fell to resume_conns, and
+// accepts what queued up meanwhile (an edge-triggered listener won't
+// report it again).
+static void ResumeAccept (struct Worker *w)
+{
+	if (w->spare_fd == -1)
+		w->spare_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+	w->retry_at = 0;
+	w->accept_paused = FALSE;
+	if (EvMod (w->loop, w->fd_server, EV_READ, NULL) == -1)
+		SystemFatal ("EvMod");
+	w->accept_pending = TRUE;
+}
+
+// Appends len bytes to the connection's output queue.
+static void QueueReply (struct Connection *c, const char *data, size_t len)
+{
+	struct OutChunk *o = c->wtail;
+	size_t n, cap;
+
+	c->wqueued += len;
+	while (len > 0)
+	{
+		if (o == NULL || o->len == o->cap)
+		{
+			cap = len > WCHUNK ? len : WCHUNK;
+			if ((o = malloc (sizeof (struct OutChunk) + cap)) == NULL)
+				SystemFatal ("malloc");
+			o->next = NULL;
+			o->off = o->len = 0;
+			o->cap = cap;
+			if (c->wtail)
+				c->wtail->next = o;
+			else
+				c->whead = o;
+			c->wtail = o;
+		}
+		n = o->cap - o->len < len ? o->cap - o->len : len;
+		memcpy (o->data + o->len, data, n);
+		o->len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+// Drops n sent bytes from the head of the output queue, freeing the chunks
+// they emptied. A lone WCHUNK chunk is kept for the next replies.
+static void ConsumeOutput (struct Connection *c, size_t n)
+{
+	struct OutChunk *o;
+	size_t step;
+
+	c->wqueued -= n;
+	while ((o = c->whead) != NULL)
+	{
+		step = o->len - o->off < n ? o->len - o->off : n;
+		o->off += step;
+		n -= step;
+		if (o->off < o->len)
+			break;
+		if (o->next == NULL && o->cap == WCHUNK)
+		{
+			o->off = o->len = 0;
+			break;
+		}
+		c->whead = o->next;
+		if (c->whead == NULL)
+			c->wtail = NULL;
+		free (o);
+	}
+}
+
+// Puts c on the worker's flush list.
+static void QueueFlush (struct Worker *w, struct Connection *c)
+{
+	if (c->flush_queued)
+		return;
+	c->flush_prev = NULL;
+	c->flush_next = w->flush_list;
+	if (w->flush_list)
+		w->flush_list->flush_prev = c;
+	w->flush_list = c;
+	c->flush_queued = TRUE;
+}
+
+static void UnqueueFlush (struct Worker *w, struct Connection *c)
+{
+	if (!c->flush_queued)
+		return;
+	if (c->flush_prev)
+		c->flush_prev->flush_next = c->flush_next;
+	else
+		w->flush_list = c->flush_next;
+	if (c->flush_next)
+		c->flush_next->flush_prev = c->flush_prev;
+	c->flush_queued = FALSE;
+}
+
+// Grows rbuf so that at least want more bytes fit after the buffered data.
+static void ReserveInput (struct Connection *c, size_t want)
+{
+	if (c->rlen + want <= c->rcap)
+		return;
+	if (c->rcap == 0)
+		c->rcap = READ_CHUNK;
+	while (c->rcap < c->rlen + want)
+		c->rcap *= 2;
+	if ((c->rbuf = realloc (c->rbuf, c->rcap)) == NULL)
+		SystemFatal ("realloc");
+}
+
+// Echoes every complete frame in buf and sets *used to the bytes consumed;
+// the rest is the start of a partial frame. The replies are the request
+// frames themselves, so a batch of pipelined requests is queued with one
+// copy. Returns CONN_DONE on a malformed frame.
+static int ParseFrames (struct Worker *w, struct Connection *c, const char *buf, size_t len, size_t *used)
+{
+	size_t off = 0, echo = 0, total;
+	uint32_t plen;
+	int type, rc = 0;
+
+	c->rneed = 0;
+	while (!c->closing)
+	{
+		// Stop at an incomplete header (0) or a malformed frame (-1)
+		if ((rc = FrameParse ((const unsigned char *) buf + off, len - off, &type, &plen)) <= 0)
+			break;
+		total = FRAME_HDRLEN + plen;
+		if (len - off < total)
+		{
+			c->rneed = total;
+			break;
+		}
+		if (type == FRAME_CLOSE)
+			c->closing = TRUE;
+		else
+		{
+			// Request logging; the reply is byte-for-byte the request frame
+			c->requests++;
+			c->bytes += plen;
+			METRIC_ADD (&w->m, messages, 1);
+			if (c->pending_msgs++ == 0)
+				c->pending_since = c->last_read;
+			echo = off + total;
+		}
+		off += total;
+	}
+	if (echo > 0)
+		QueueReply (c, buf, echo);
+	*used = off;
+	return rc < 0 ? CONN_DONE : CONN_OPEN;
+}
+
+// Reads everything the socket has buffered and echoes every complete frame,
+// up to EAGAIN or until WBUF_HIGH of output is queued (read_blocked).
+// Returns CONN_DONE when the connection should be closed.
+static int ReadSocket (struct Worker *w, struct Connection *c)
+{
+	ssize_t	n;
+	size_t want, used;
+
+	c->read_blocked = FALSE;
+	while (!c->closing)
+	{
+		// Apply back-pressure to clients that don't read their replies
+		if (c->wqueued >= WBUF_HIGH)
+		{
+			c->read_blocked = TRUE;
+			break;
+		}
+
+		// Between frames, read into the worker's scratch buffer
+		if (c->rlen == 0)
+		{
+			n = recv (c->fd, w->scratch, READ_CHUNK, 0);
+		}
+		else
+		{
+			// Make room for the rest of a large frame in one go
+			want = READ_CHUNK;
+			if (c->rneed > c->rlen + want)
+				want = c->rneed - c->rlen;
+			ReserveInput (c, want);
+			n = recv (c->fd, c->rbuf + c->rlen, c->rcap - c->rlen, 0);
+		}
+		METRIC_ADD (&w->m, syscalls, 1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
 			{
-				event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
-				event.data.fd = fd_server;
-				epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd_server, &event);
-				modified = 0;
-				firstRun = 0;
+				METRIC_ADD (&w->m, eagain_read, 1);
+				break;		// nothing more for now, epoll will tell us
 			}
-    	}
-	close(fd_server);
-	exit (EXIT_SUCCESS);
+			return CONN_DONE;
+		}
+		if (n == 0)
+			return CONN_DONE;	// peer closed without a close frame
+		METRIC_ADD (&w->m, bytes_in, n);
+		c->last_read = MetricsNow ();
+
+		if (c->rlen == 0)
+		{
+			if (ParseFrames (w, c, w->scratch, n, &used) == CONN_DONE)
+				return CONN_DONE;
+
+			// Keep the partial frame, sized for all of it when known
+			if (used < (size_t) n && !c->closing)
+			{
+				ReserveInput (c, c->rneed > n - used ? c->rneed : n - used);
+				memcpy (c->rbuf, w->scratch + used, n - used);
+				c->rlen = n - used;
+			}
+			continue;
+		}
+
+		c->rlen += n;
+		if (ParseFrames (w, c, c->rbuf, c->rlen, &used) == CONN_DONE)
+			return CONN_DONE;
+
+		// Keep any partial frame for the next read
+		memmove (c->rbuf, c->rbuf + used, c->rlen - used);
+		c->rlen -= used;
+
+		// The partial frame is complete; give its buffer back
+		if (c->rlen == 0)
+		{
+			free (c->rbuf);
+			c->rbuf = NULL;
+			c->rcap = 0;
+		}
+	}
+	return CONN_OPEN;
 }
 
-static int ClearSocket (int fd)
+// Reads and echoes what the socket has buffered and returns to the event
+// loop on EAGAIN. Returns CONN_DONE when the connection should be closed.
+static int ClearSocket (struct Worker *w, struct Connection *c)
 {
-	int	n, bytes_to_read;
-	char *bp, buf[BUFLEN];
+	int state;
 
-	while (TRUE)
+	while (ReadSocket (w, c) == CONN_OPEN)
 	{
+		// Hold the replies for the end of the pass, when all of them go out
+		// in one write; a pile of them, or a socket that refused the last
+		// write, doesn't wait
+		if (c->wqueued >= FLUSH_HIGH)
+		{
+			state = FlushSocket (w, c);
 
-		bp = buf;
-		bytes_to_read = BUFLEN;
-		n = recv (fd, bp, bytes_to_read, 0);
-		if(errno == EAGAIN)
+			// Input left unread when reading paused brings no new edge, so
+			// a flush that drained the output without EAGAIN reads on
+			if (state == CONN_OPEN && c->read_blocked && c->wqueued == 0)
+				continue;
+			return state;
+		}
+		if (c->wqueued > 0)
 		{
-			printf("EAGAIN\n");
-			//MORE TO READ, SEND BACK TO OUTER LOOP
-			errno = 0;
-			sleep(1);
+			if (!c->write_blocked)
+				QueueFlush (w, c);
+			return CONN_OPEN;
+		}
+		return c->closing ? CONN_DONE : CONN_OPEN;
+	}
+	return CONN_DONE;
+}
+
+// Keeps a level-triggered backend watching only for what c can act on:
+// writability while the socket refuses queued replies (or a relayed
+// payload is queued), readability unless reading is paused. Replies held
+// for the flush need no event. Edge-triggered epoll needs no updates.
+static void UpdateInterest (struct Worker *w, struct Connection *c)
+{
+	int want;
+
+	if (backend == EV_EPOLL_ET)
+		return;
+	if (zero_copy && (c->in_pipe > 0 || c->wqueued > 0))
+		want = EV_WRITE;	// the relay reads again once the output is out
+	else
+	{
+		// A flush may have drained the output that paused reading
+		want = c->write_blocked ? EV_WRITE : 0;
+		if (!c->closing && !(c->read_blocked && c->wqueued > 0))
+			want |= EV_READ;
+	}
+	if (want == c->interest)
+		return;
+	if (EvMod (w->loop, c->fd, want, c) == -1)
+		SystemFatal ("EvMod");
+	if (backend == EV_EPOLL_LT)
+		METRIC_ADD (&w->m, syscalls, 1);
+	c->interest = want;
+}
+
+// Counts the replies queued since the output last drained as answered now.
+static void RecordLatency (struct Worker *w, struct Connection *c)
+{
+	if (c->pending_msgs == 0)
+		return;
+	HistRecordN (&w->m.latency, MetricsNow () - c->pending_since, c->pending_msgs);
+	c->pending_msgs = 0;
+}
+
+// Sets or clears TCP_CORK (-C). A corked socket sends only full segments,
+// so a flush that takes several writes still leaves in full segments.
+static void CorkSocket (struct Worker *w, struct Connection *c, int on)
+{
+	if (setsockopt (c->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof (on)) == -1)
+		perror ("setsockopt TCP_CORK");
+	METRIC_ADD (&w->m, syscalls, 1);
+	c->corked = on;
+}
+
+// Sends as much queued output as the socket accepts, gathering the queued
+// chunks into one sendmsg. A short write leaves the rest queued until the
+// socket is writable again.
+static int FlushSocket (struct Worker *w, struct Connection *c)
+{
+	struct iovec iov[FLUSH_IOV];
+	struct msghdr msg;
+	struct OutChunk *o;
+	size_t want;
+	ssize_t n;
+	int i, flags;
+	int relay = c->splice_in > 0 || c->in_pipe > 0;
+
+	UnqueueFlush (w, c);
+	c->write_blocked = FALSE;
+	if (cork && !c->corked && c->wqueued > 0)
+		CorkSocket (w, c, TRUE);
+
+	while (c->wqueued > 0)
+	{
+		want = 0;
+		for (i = 0, o = c->whead; o != NULL && i < FLUSH_IOV; o = o->next, i++)
+		{
+			iov[i].iov_base = o->data + o->off;
+			iov[i].iov_len = o->len - o->off;
+			want += iov[i].iov_len;
+		}
+		memset (&msg, 0, sizeof (msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = i;
+
+		// More is coming: the rest of the queue, or a relayed header's payload
+		flags = MSG_NOSIGNAL;
+		if (o != NULL || relay)
+			flags |= MSG_MORE;
+
+		n = sendmsg (c->fd, &msg, flags);
+		METRIC_ADD (&w->m, syscalls, 1);
+		METRIC_ADD (&w->m, writes, 1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				METRIC_ADD (&w->m, eagain_write, 1);
+				c->write_blocked = TRUE;
+				return CONN_OPEN;
+			}
+			return CONN_DONE;
+		}
+		METRIC_ADD (&w->m, bytes_out, n);
+		if ((size_t) n < want)
+			METRIC_ADD (&w->m, partial_writes, 1);
+		ConsumeOutput (c, n);
+	}
+
+	// A relayed reply is complete only once its payload is out too
+	if (!relay)
+	{
+		RecordLatency (w, c);
+		if (c->corked)
+			CorkSocket (w, c, FALSE);
+	}
+
+	return c->closing ? CONN_DONE : CONN_OPEN;
+}
+
+// Flushes the connections holding replies: all of them, or with -F those
+// whose oldest reply has waited flush_delay (or that are closing). Returns
+// the EvWait timeout in microseconds until the next held reply is due, -1
+// if none is held. The stats port's msgs_per_write shows how many echoed
+// messages each write carried.
+static long FlushPending (struct Worker *w)
+{
+	struct Connection *c, *next;
+	uint64_t now = flush_delay ? MetricsNow () : 0;
+	uint64_t due, first = 0, start;
+	int state;
+
+	for (c = w->flush_list; c != NULL; c = next)
+	{
+		next = c->flush_next;
+		due = c->pending_since + flush_delay;
+		if (flush_delay && now < due && !c->closing)
+		{
+			if (first == 0 || due < first)
+				first = due;
 			continue;
 		}
+		start = TscNow ();
+		state = FlushSocket (w, c);
+
+		// Reading paused for this output; nothing will signal the input
+		// already buffered, so read it now and flush what it produces
+		while (state == CONN_OPEN && c->read_blocked && c->wqueued == 0)
+			if ((state = ClearSocket (w, c)) == CONN_OPEN && c->flush_queued)
+				state = FlushSocket (w, c);
+		if (state == CONN_DONE)
+		{
+			c->active += TscNow () - start;
+			CloseConnection (w, c);
+		}
 		else
 		{
-			// Request logging
-			requests_log[fd]++;
+			UpdateInterest (w, c);
+			c->active += TscNow () - start;
+		}
+	}
+	if (first == 0)
+		return -1;
+	return (first - now + 999) / 1000;
+}
 
-			if(buf[0] != '\0')
+// Starts c's timer: the handshake timeout runs from accept to the first
+// frame, then the idle timeout from the latest input.
+static void ArmTimer (struct Worker *w, struct Connection *c)
+{
+	if (handshake_timeout && c->requests == 0 && !c->closing)
+		WheelAdd (&w->wheel, &c->timer, handshake_timeout);
+	else if (idle_timeout)
+		WheelAdd (&w->wheel, &c->timer, idle_timeout);
+}
+
+// Runs the timer wheel up to now and closes the connections that timed out.
+// Reads only stamp last_read; an idle timer that finds later input is
+// rearmed for the rest of its time instead of being moved on every read.
+static void ExpireConnections (struct Worker *w)
+{
+	struct Connection *c;
+	struct Timer *t, *next;
+	uint64_t ticks, now, quiet;
+
+	w->timer_pending = FALSE;
+	while (read (w->timer_fd, &ticks, sizeof (ticks)) == -1 && errno == EINTR)
+		;
+	METRIC_ADD (&w->m, syscalls, 1);
+
+	now = MetricsNow ();
+	for (t = WheelAdvance (&w->wheel, now); t != NULL; t = next)
+	{
+		next = t->next;
+		c = TIMER_OWNER (t, struct Connection, timer);
+		quiet = now - c->last_read;
+		// Past its first frame a connection is only closed when idle
+		if (!handshake_timeout || c->requests > 0 || c->closing)
+		{
+			if (idle_timeout == 0)
+				continue;	// handshake done and no idle limit
+			if (quiet < idle_timeout)
 			{
-				send (fd, buf, BUFLEN, 0);
-				return TRUE;
+				WheelAdd (&w->wheel, &c->timer, idle_timeout - quiet);
+				continue;
 			}
+		}
+		METRIC_ADD (&w->m, timeouts, 1);
+		CloseConnection (w, c);
+	}
+}
+
+// Echoes the datagrams waiting on the worker's UDP socket, udp_batch at a
+// time, each back to its sender from the slot it landed in. Replies the
+// socket buffer can't take are dropped, as UDP would. A batch shorter than
+// udp_batch means recvmmsg found the socket empty, and the next datagram
+// raises a new edge.
+static void EchoDatagrams (struct Worker *w)
+{
+	struct mmsghdr *msgs = w->udp_msgs;
+	uint64_t start;
+	size_t out;
+	int i, n, sent, rc;
+
+	while (TRUE)
+	{
+		for (i = 0; i < udp_batch; i++)
+		{
+			w->udp_iov[i].iov_len = UDP_MAXLEN;
+			msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
+		}
+		n = recvmmsg (w->udp_fd, msgs, udp_batch, MSG_DONTWAIT, NULL);
+		METRIC_ADD (&w->m, syscalls, 1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				METRIC_ADD (&w->m, eagain_read, 1);
 			else
-				break;
+				perror ("recvmmsg");
+			return;
+		}
+		start = MetricsNow ();
+
+		// Each reply is its request, sent back from the same slot
+		for (i = 0; i < n; i++)
+		{
+			w->udp_iov[i].iov_len = msgs[i].msg_len;
+			METRIC_ADD (&w->m, bytes_in, msgs[i].msg_len);
+		}
+		METRIC_ADD (&w->m, messages, n);
+
+		for (sent = 0; sent < n; sent += rc)
+		{
+			rc = sendmmsg (w->udp_fd, msgs + sent, n - sent, MSG_DONTWAIT);
+			METRIC_ADD (&w->m, syscalls, 1);
+			METRIC_ADD (&w->m, writes, 1);
+			if (rc == -1)
+			{
+				if (errno == EINTR)
+				{
+					rc = 0;
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					msgs[sent].msg_len = 0;
+					rc = 1;		// skip the datagram that failed
+					continue;
+				}
+				METRIC_ADD (&w->m, eagain_write, 1);
+				break;		// the rest of the batch is dropped
+			}
+			if (rc < n - sent)
+				METRIC_ADD (&w->m, partial_writes, 1);
 		}
+
+		for (out = 0, i = 0; i < sent; i++)
+			out += msgs[i].msg_len;
+		METRIC_ADD (&w->m, bytes_out, out);
+		if (sent > 0)
+			HistRecordN (&w->m.latency, MetricsNow () - start, sent);
+		if (n < udp_batch)
+			return;
 	}
+}
 
-	// Request logging
-	fprintf(stderr, "Requests recorded for client[%s:%d]: %d\n",  client_ip[fd], client_port[fd], requests_log[fd]);
-	requests_log[fd] = 0;
-	return(0);
+// Lends c a relay pipe from the worker's pool, creating one if it is empty.
+static int GetPipe (struct Worker *w, struct Connection *c)
+{
+	if (w->num_pipes > 0)
+	{
+		w->num_pipes--;
+		c->pipe_fd[0] = w->pipes[w->num_pipes][0];
+		c->pipe_fd[1] = w->pipes[w->num_pipes][1];
+		return 0;
+	}
+	if (pipe2 (c->pipe_fd, O_NONBLOCK | O_CLOEXEC) == -1)
+	{
+		perror ("pipe2");
+		return -1;
+	}
+	// A larger pipe moves more payload per splice; the default is fine too
+	fcntl (c->pipe_fd[1], F_SETPIPE_SZ, PIPE_SIZE);
+	return 0;
+}
+
+// Returns c's pipe to the pool. A pipe that still holds data is closed.
+static void PutPipe (struct Worker *w, struct Connection *c)
+{
+	if (c->in_pipe == 0 && w->num_pipes < PIPE_POOL_MAX)
+	{
+		w->pipes[w->num_pipes][0] = c->pipe_fd[0];
+		w->pipes[w->num_pipes][1] = c->pipe_fd[1];
+		w->num_pipes++;
+	}
+	else
+	{
+		close (c->pipe_fd[0]);
+		close (c->pipe_fd[1]);
+	}
+	c->pipe_fd[0] = c->pipe_fd[1] = -1;
+}
+
+// Zero-copy echo. Only frame headers are read into user space; the header
+// is queued as the reply and the payload is spliced socket -> pipe -> socket
+// without entering user space, through a pipe from the worker's pool
+// (GetPipe). Returns on EAGAIN in either direction, both of which epoll
+// reports on the connection's (edge-triggered) IN/OUT events.
+static int SpliceSocket (struct Worker *w, struct Connection *c)
+{
+	ssize_t n;
+	uint32_t len;
+	int type, rc, out_blocked;
+
+	while (TRUE)
+	{
+		// The header must be on the wire before its payload
+		if (c->wqueued > 0)
+		{
+			if (FlushSocket (w, c) == CONN_DONE)
+				return CONN_DONE;
+			if (c->wqueued > 0)
+				return CONN_OPEN;
+		}
+		if (c->closing)
+			return FlushSocket (w, c);
+
+		// Payload in the pipe goes out first
+		out_blocked = FALSE;
+		if (c->in_pipe > 0)
+		{
+			n = splice (c->pipe_fd[0], NULL, c->fd, NULL, c->in_pipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			METRIC_ADD (&w->m, syscalls, 1);
+			METRIC_ADD (&w->m, writes, 1);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN)
+					return CONN_DONE;
+				METRIC_ADD (&w->m, eagain_write, 1);
+				out_blocked = TRUE;
+			}
+			else
+			{
+				METRIC_ADD (&w->m, bytes_out, n);
+				c->in_pipe -= n;
+			}
+		}
 
+		// Then refill the pipe from the socket
+		if (c->splice_in > 0)
+		{
+			n = splice (c->fd, NULL, c->pipe_fd[1], NULL, c->splice_in, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			METRIC_ADD (&w->m, syscalls, 1);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN)
+					return CONN_DONE;
+				METRIC_ADD (&w->m, eagain_read, 1);
+				// With an empty pipe the socket is drained; with a full
+				// pipe wait for the socket to take more. Either way the
+				// edge comes from epoll.
+				if (c->in_pipe == 0 || out_blocked)
+					return CONN_OPEN;
+				continue;
+			}
+			if (n == 0)
+				return CONN_DONE;	// peer closed mid-frame
+			c->last_read = MetricsNow ();
+			c->splice_in -= n;
+			c->in_pipe += n;
+			c->spliced += n;
+			METRIC_ADD (&w->m, bytes_in, n);
+			METRIC_ADD (&w->m, spliced, n);
+			continue;
+		}
+		if (c->in_pipe > 0)
+		{
+			if (out_blocked)
+				return CONN_OPEN;
+			continue;
+		}
+
+		// Frame relayed; the pipe goes back to the pool for other connections
+		RecordLatency (w, c);
+		if (c->corked)
+			CorkSocket (w, c, FALSE);
+		if (c->pipe_fd[0] != -1)
+			PutPipe (w, c);
+
+		// Read the next header only, leaving its payload in the socket
+		n = recv (c->fd, c->hdr + c->hlen, FRAME_HDRLEN - c->hlen, 0);
+		METRIC_ADD (&w->m, syscalls, 1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				METRIC_ADD (&w->m, eagain_read, 1);
+				return CONN_OPEN;
+			}
+			return CONN_DONE;
+		}
+		if (n == 0)
+			return CONN_DONE;	// peer closed without a close frame
+		METRIC_ADD (&w->m, bytes_in, n);
+		c->last_read = MetricsNow ();
+		c->hlen += n;
+
+		rc = FrameParse (c->hdr, c->hlen, &type, &len);
+		if (rc == 0)
+			continue;
+		if (rc < 0)
+			return CONN_DONE;
+		c->hlen = 0;
+		if (type == FRAME_CLOSE)
+		{
+			c->closing = TRUE;
+			continue;
+		}
+
+		// Request logging; the reply header is the request header
+		c->requests++;
+		c->bytes += len;
+		METRIC_ADD (&w->m, messages, 1);
+		c->pending_since = c->last_read;
+		c->pending_msgs = 1;
+		QueueReply (c, (char *) c->hdr, FRAME_HDRLEN);
+		if (len > 0)
+		{
+			if (GetPipe (w, c) == -1)
+				return CONN_DONE;
+			c->splice_in = len;
+		}
+	}
 }
 
 // Prints the error stored in errno and aborts the program.
@@ -295,9 +1762,13 @@ static void SystemFatal(const char* message)
     exit (EXIT_FAILURE);
 }
 
-// close fd
-void close_fd (int signo)
+// Asks every worker to return; main then drains the log and exits.
+static void Stop (int signo)
 {
-    close(fd_server);
-	exit (EXIT_SUCCESS);
+	uint64_t one = 1;
+	int i;
+
+	stopping = TRUE;
+	for (i = 0; i < num_workers; i++)
+		write (workers[i].wake_fd, &one, sizeof (one));
 }
@@ -0,0 +1,384 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		evloop.c -   Readiness notification behind one interface
+--
+--	FUNCTIONS:		EvBackendByName
+--				EvCreate
+--				EvAdd
+--				EvMod
+--				EvDel
+--				EvWait
+--				EvBusyPoll
+--				EvDestroy
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See evloop.h. select and poll keep per-descriptor state in arrays
+--	indexed by fd (grown on demand); poll also keeps the pollfd array
+--	compact by moving the last entry into the hole left by EvDel. Functions
+--	return 0 (EvWait: the number of events), or -1 with errno set.
+--	Timeouts are in microseconds: select takes a timeval, poll is ppoll and
+--	epoll is epoll_pwait2 where the C library and the kernel have it (glibc
+--	2.35, Linux 5.11); plain epoll_wait rounds up to whole milliseconds.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE	// POLLRDHUP
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <time.h>
+#include "evloop.h"
+
+#if defined (__GLIBC__) && __GLIBC_PREREQ (2, 35)
+#define HAVE_EPOLL_PWAIT2
+#endif
+
+#define EV_BUSY_BUDGET	64	// packets per busy-poll pass, NAPI_POLL_WEIGHT
+
+// Per-instance busy-poll parameters (Linux 6.9), missing from older
+// headers; the layout is the kernel's struct epoll_params
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+	uint32_t busy_poll_usecs;
+	uint16_t busy_poll_budget;
+	uint8_t prefer_busy_poll;
+	uint8_t pad;
+};
+#define EPIOCSPARAMS	_IOW (0x8A, 0x01, struct epoll_params)
+#endif
+
+struct EvLoop
+{
+	int backend;
+
+	// By descriptor: the caller's pointer, interest and pollfd slot
+	void **ptrs;
+	int *interest;
+	int *slot;
+	int fdcap;
+
+	// select
+	fd_set rset, wset;
+	int maxfd;
+
+	// poll
+	struct pollfd *pfds;
+	int npfds, pfdcap;
+
+	// epoll
+	int epoll_fd;
+	struct epoll_event *events;
+	int max_events;
+};
+
+static const char *names[] = { "select", "poll", "epoll-lt", "epoll-et" };
+
+int EvBackendByName (const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int) (sizeof (names) / sizeof (names[0])); i++)
+		if (strcmp (name, names[i]) == 0)
+			return i;
+	return -1;
+}
+
+const char *EvBackendName (int backend)
+{
+	return names[backend];
+}
+
+struct EvLoop *EvCreate (int backend, int max_events)
+{
+	struct EvLoop *loop;
+
+	if ((loop = calloc (1, sizeof (*loop))) == NULL)
+		return NULL;
+	loop->backend = backend;
+	loop->epoll_fd = -1;
+	loop->maxfd = -1;
+	FD_ZERO (&loop->rset);
+	FD_ZERO (&loop->wset);
+
+	if (backend == EV_EPOLL_LT || backend == EV_EPOLL_ET)
+	{
+		loop->max_events = max_events;
+		loop->events = calloc (max_events, sizeof (struct epoll_event));
+		if (loop->events == NULL || (loop->epoll_fd = epoll_create1 (EPOLL_CLOEXEC)) == -1)
+		{
+			EvDestroy (loop);
+			return NULL;
+		}
+	}
+	return loop;
+}
+
+// Makes the by-descriptor arrays big enough for fd.
+static int GrowFds (struct EvLoop *loop, int fd)
+{
+	int cap = loop->fdcap ? loop->fdcap : 1024;
+	void *p;
+
+	if (fd < loop->fdcap)
+		return 0;
+	while (cap <= fd)
+		cap *= 2;
+	if ((p = realloc (loop->ptrs, cap * sizeof (void *))) == NULL)
+		return -1;
+	loop->ptrs = p;
+	if ((p = realloc (loop->interest, cap * sizeof (int))) == NULL)
+		return -1;
+	loop->interest = p;
+	if ((p = realloc (loop->slot, cap * sizeof (int))) == NULL)
+		return -1;
+	loop->slot = p;
+	loop->fdcap = cap;
+	return 0;
+}
+
+static uint32_t EpollEvents (struct EvLoop *loop, int interest)
+{
+	// Edge-triggered descriptors always watch both directions
+	if (loop->backend == EV_EPOLL_ET)
+		return EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	return (interest & EV_READ ? EPOLLIN | EPOLLRDHUP : 0) | (interest & EV_WRITE ? EPOLLOUT : 0);
+}
+
+static short PollEvents (int interest)
+{
+	return (interest & EV_READ ? POLLIN | POLLRDHUP : 0) | (interest & EV_WRITE ? POLLOUT : 0);
+}
+
+// Sets fd's interest in the select sets
+static void SetSelect (struct EvLoop *loop, int fd, int interest)
+{
+	if (interest & EV_READ)
+		FD_SET (fd, &loop->rset);
+	else
+		FD_CLR (fd, &loop->rset);
+	if (interest & EV_WRITE)
+		FD_SET (fd, &loop->wset);
+	else
+		FD_CLR (fd, &loop->wset);
+}
+
+int EvAdd (struct EvLoop *loop, int fd, int interest, void *ptr)
+{
+	struct epoll_event event;
+	void *p;
+
+	switch (loop->backend)
+	{
+	case EV_SELECT:
+		if (fd >= FD_SETSIZE)
+		{
+			errno = EMFILE;
+			return -1;
+		}
+		if (GrowFds (loop, fd) == -1)
+			return -1;
+		SetSelect (loop, fd, interest);
+		if (fd > loop->maxfd)
+			loop->maxfd = fd;
+		break;
+
+	case EV_POLL:
+		if (GrowFds (loop, fd) == -1)
+			return -1;
+		if (loop->npfds == loop->pfdcap)
+		{
+			loop->pfdcap = loop->pfdcap ? loop->pfdcap * 2 : 1024;
+			if ((p = realloc (loop->pfds, loop->pfdcap * sizeof (struct pollfd))) == NULL)
+				return -1;
+			loop->pfds = p;
+		}
+		loop->slot[fd] = loop->npfds;
+		loop->pfds[loop->npfds].fd = fd;
+		loop->pfds[loop->npfds].events = PollEvents (interest);
+		loop->pfds[loop->npfds].revents = 0;
+		loop->npfds++;
+		break;
+
+	default:
+		memset (&event, 0, sizeof (event));
+		event.events = EpollEvents (loop, interest);
+		event.data.ptr = ptr;
+		return epoll_ctl (loop->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+	}
+	loop->ptrs[fd] = ptr;
+	loop->interest[fd] = interest;
+	return 0;
+}
+
+int EvMod (struct EvLoop *loop, int fd, int interest, void *ptr)
+{
+	struct epoll_event event;
+
+	switch (loop->backend)
+	{
+	case EV_SELECT:
+		SetSelect (loop, fd, interest);
+		break;
+	case EV_POLL:
+		loop->pfds[loop->slot[fd]].events = PollEvents (interest);
+		break;
+	case EV_EPOLL_LT:
+		memset (&event, 0, sizeof (event));
+		event.events = EpollEvents (loop, interest);
+		event.data.ptr = ptr;
+		return epoll_ctl (loop->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+	default:
+		return 0;	// nothing to change when edge-triggered
+	}
+	loop->ptrs[fd] = ptr;
+	loop->interest[fd] = interest;
+	return 0;
+}
+
+int EvDel (struct EvLoop *loop, int fd)
+{
+	int i;
+
+	switch (loop->backend)
+	{
+	case EV_SELECT:
+		SetSelect (loop, fd, 0);
+		while (loop->maxfd >= 0 && !FD_ISSET (loop->maxfd, &loop->rset) && !FD_ISSET (loop->maxfd, &loop->wset))
+			loop->maxfd--;
+		break;
+	case EV_POLL:
+		// Move the last entry into the hole
+		i = loop->slot[fd];
+		loop->pfds[i] = loop->pfds[--loop->npfds];
+		loop->slot[loop->pfds[i].fd] = i;
+		break;
+	default:
+		return epoll_ctl (loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	}
+	loop->ptrs[fd] = NULL;
+	loop->interest[fd] = 0;
+	return 0;
+}
+
+// Waits up to timeout microseconds (-1 forever) and fills in at most max
+// events. Descriptors ready beyond max are reported by the next call.
+int EvWait (struct EvLoop *loop, struct EvEvent *events, int max, long timeout)
+{
+	struct timeval tv, *tvp = NULL;
+	struct timespec ts, *tsp = NULL;
+	fd_set rset, wset;
+	int i, n, fd, ev, count = 0;
+	short re;
+	uint32_t ee;
+
+	switch (loop->backend)
+	{
+	case EV_SELECT:
+		rset = loop->rset;	// structure assignment
+		wset = loop->wset;
+		if (timeout >= 0)
+		{
+			tv.tv_sec = timeout / 1000000;
+			tv.tv_usec = timeout % 1000000;
+			tvp = &tv;
+		}
+		if ((n = select (loop->maxfd + 1, &rset, &wset, NULL, tvp)) <= 0)
+			return n;
+		for (fd = 0; fd <= loop->maxfd && count < max && n > 0; fd++)
+		{
+			ev = (FD_ISSET (fd, &rset) ? EV_READ : 0) | (FD_ISSET (fd, &wset) ? EV_WRITE : 0);
+			if (ev == 0)
+				continue;
+			n--;
+			events[count].ptr = loop->ptrs[fd];
+			events[count++].events = ev;
+		}
+		return count;
+
+	case EV_POLL:
+		if (timeout >= 0)
+		{
+			ts.tv_sec = timeout / 1000000;
+			ts.tv_nsec = (timeout % 1000000) * 1000;
+			tsp = &ts;
+		}
+		if ((n = ppoll (loop->pfds, loop->npfds, tsp, NULL)) <= 0)
+			return n;
+		for (i = 0; i < loop->npfds && count < max && n > 0; i++)
+		{
+			if ((re = loop->pfds[i].revents) == 0)
+				continue;
+			n--;
+			events[count].ptr = loop->ptrs[loop->pfds[i].fd];
+			events[count++].events = (re & (POLLIN | POLLRDHUP) ? EV_READ : 0) | (re & POLLOUT ? EV_WRITE : 0)
+				| (re & (POLLHUP | POLLERR | POLLNVAL) ? EV_ERROR : 0);
+		}
+		return count;
+
+	default:
+		if (max > loop->max_events)
+			max = loop->max_events;
+		n = -1;
+		errno = ENOSYS;
+#ifdef HAVE_EPOLL_PWAIT2
+		if (timeout >= 0)
+		{
+			ts.tv_sec = timeout / 1000000;
+			ts.tv_nsec = (timeout % 1000000) * 1000;
+			tsp = &ts;
+		}
+		n = epoll_pwait2 (loop->epoll_fd, loop->events, max, tsp, NULL);
+#endif
+		if (n == -1 && errno == ENOSYS)
+			n = epoll_wait (loop->epoll_fd, loop->events, max, timeout < 0 ? -1 : (timeout + 999) / 1000);
+		if (n <= 0)
+			return n;
+		for (i = 0; i < n; i++)
+		{
+			ee = loop->events[i].events;
+			events[i].ptr = loop->events[i].data.ptr;
+			events[i].events = (ee & (EPOLLIN | EPOLLRDHUP) ? EV_READ : 0) | (ee & EPOLLOUT ? EV_WRITE : 0)
+				| (ee & (EPOLLHUP | EPOLLERR) ? EV_ERROR : 0);
+		}
+		return n;
+	}
+}
+
+// Makes an epoll loop busy-poll the device queues of its sockets for up
+// to usecs before sleeping in EvWait. Sockets whose packets come through
+// NAPI (not loopback) benefit; 0 turns it off. Fails with EOPNOTSUPP on
+// the other backends and ENOTTY on kernels before 6.9.
+int EvBusyPoll (struct EvLoop *loop, unsigned int usecs)
+{
+	struct epoll_params params;
+
+	if (loop->epoll_fd == -1)
+	{
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+	memset (&params, 0, sizeof (params));
+	params.busy_poll_usecs = usecs;
+	params.busy_poll_budget = EV_BUSY_BUDGET;
+	return ioctl (loop->epoll_fd, EPIOCSPARAMS, &params);
+}
+
+void EvDestroy (struct EvLoop *loop)
+{
+	if (loop->epoll_fd != -1)
+		close (loop->epoll_fd);
+	free (loop->events);
+	free (loop->pfds);
+	free (loop->ptrs);
+	free (loop->interest);
+	free (loop->slot);
+	free (loop);
+}
@@ -0,0 +1,74 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		evloop.h -   Readiness notification behind one interface
+--
+--	FUNCTIONS:		EvBackendByName
+--				EvCreate
+--				EvAdd
+--				EvMod
+--				EvDel
+--				EvWait
+--				EvBusyPoll
+--				EvDestroy
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	One event loop API over four mechanisms, chosen at run time:
+--
+--		select		fd_sets rebuilt by the kernel call, scanned up to
+--				the highest descriptor; descriptors must stay
+--				below FD_SETSIZE
+--		poll		a compact pollfd array, scanned in full
+--		epoll-lt	epoll, level-triggered
+--		epoll-et	epoll, edge-triggered
+--
+--	The first three are level-triggered: a descriptor is reported for as
+--	long as it is ready for what it is registered for, so the caller must
+--	keep the interest set (EV_READ, EV_WRITE) to what it will act on, e.g.
+--	EV_WRITE only while output is queued. With epoll-et every descriptor
+--	is reported on readiness changes only, whatever EvMod says; the caller
+--	registers both directions once and reads and writes until EAGAIN.
+--
+--	An EvLoop belongs to one thread. Every descriptor carries a pointer
+--	that EvWait hands back with its events. EvWait's timeout is in
+--	microseconds, -1 to wait indefinitely.
+--
+--	EvBusyPoll has an epoll instance busy-poll its sockets' device queues
+--	in the kernel before it sleeps (EPIOCSPARAMS, Linux 6.9); where the C
+--	library doesn't expose that, or for the other backends, it fails with
+--	EOPNOTSUPP.
+---------------------------------------------------------------------------------------*/
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#define EV_SELECT	0
+#define EV_POLL		1
+#define EV_EPOLL_LT	2
+#define EV_EPOLL_ET	3
+
+// Interest and event flags
+#define EV_READ		0x01
+#define EV_WRITE	0x02
+#define EV_ERROR	0x04	// hang-up or error (reported only)
+
+struct EvEvent
+{
+	void *ptr;
+	int events;
+};
+
+struct EvLoop;
+
+int EvBackendByName (const char *name);
+const char *EvBackendName (int backend);
+struct EvLoop *EvCreate (int backend, int max_events);
+int EvAdd (struct EvLoop *loop, int fd, int interest, void *ptr);
+int EvMod (struct EvLoop *loop, int fd, int interest, void *ptr);
+int EvDel (struct EvLoop *loop, int fd);
+int EvWait (struct EvLoop *loop, struct EvEvent *events, int max, long timeout);
+int EvBusyPoll (struct EvLoop *loop, unsigned int usecs);
+void EvDestroy (struct EvLoop *loop);
+
+#endif
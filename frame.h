@@ -0,0 +1,190 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		frame.h -   Length-prefixed message framing
+--
+--	FUNCTIONS:		FrameHeader
+--				FrameParse
+--				FrameSend
+--				FrameWriten
+--				FrameRecv
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Wire format shared by the servers and the clients. Every message is a
+--	4 byte header in network byte order followed by the payload:
+--
+--		bits 31-24	frame type (FRAME_DATA or FRAME_CLOSE)
+--		bits 23-0	payload length in bytes (at most FRAME_MAXLEN)
+--
+--	The servers echo FRAME_DATA frames back unchanged. A FRAME_CLOSE frame
+--	(normally with an empty payload) ends the session; the server logs the
+--	client and closes the connection once its replies are sent.
+--
+--	FrameSend and FrameRecv are blocking helpers for the clients; the
+--	servers parse frames out of their own buffers with FrameParse, and the
+--	select server echoes a batch of them with FrameWriten.
+---------------------------------------------------------------------------------------*/
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define FRAME_HDRLEN	4
+#define FRAME_MAXLEN	((1U << 24) - 1)	// 16 MB - 1
+#define FRAME_DATA	0x01
+#define FRAME_CLOSE	0x02
+
+// Writes the header for a frame of the given type and payload length.
+static inline void FrameHeader (unsigned char *hdr, int type, uint32_t len)
+{
+	uint32_t word = htonl (((uint32_t) type << 24) | (len & FRAME_MAXLEN));
+
+	hdr[0] = ((unsigned char *) &word)[0];
+	hdr[1] = ((unsigned char *) &word)[1];
+	hdr[2] = ((unsigned char *) &word)[2];
+	hdr[3] = ((unsigned char *) &word)[3];
+}
+
+// Decodes the header at buf. Returns 1 on success, 0 if fewer than
+// FRAME_HDRLEN bytes are available and -1 if the type is unknown.
+static inline int FrameParse (const unsigned char *buf, size_t avail, int *type, uint32_t *len)
+{
+	uint32_t word;
+
+	if (avail < FRAME_HDRLEN)
+		return 0;
+	word = ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+	*type = word >> 24;
+	*len = word & FRAME_MAXLEN;
+	return (*type == FRAME_DATA || *type == FRAME_CLOSE) ? 1 : -1;
+}
+
+// Sends one complete frame on a blocking socket. Returns 0 or -1 on error.
+static inline int FrameSend (int fd, int type, const void *payload, uint32_t len)
+{
+	unsigned char hdr[FRAME_HDRLEN];
+	struct iovec iov[2];
+	int iovcnt = len > 0 ? 2 : 1;
+	ssize_t n;
+
+	if (len > FRAME_MAXLEN)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	FrameHeader (hdr, type, len);
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = FRAME_HDRLEN;
+	iov[1].iov_base = (void *) payload;
+	iov[1].iov_len = len;
+
+	// writev may stop short on a socket; resume where it left off
+	while (iovcnt > 0)
+	{
+		n = writev (fd, iov + (2 - iovcnt), iovcnt);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		while (iovcnt > 0 && (size_t) n >= iov[2 - iovcnt].iov_len)
+		{
+			n -= iov[2 - iovcnt].iov_len;
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			iov[2 - iovcnt].iov_base = (char *) iov[2 - iovcnt].iov_base + n;
+			iov[2 - iovcnt].iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+// Writes all len bytes to a blocking socket. Returns 0 or -1 on error.
+static inline int FrameWriten (int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len)
+	{
+		n = write (fd, (const char *) buf + done, len - done);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+	return 0;
+}
+
+// Reads exactly len bytes from a blocking socket. Returns len, 0 on EOF
+// before the first byte or -1 on error (including EOF mid-message).
+static inline ssize_t FrameReadn (int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len)
+	{
+		n = read (fd, (char *) buf + done, len - done);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+		{
+			if (done == 0)
+				return 0;
+			errno = ECONNRESET;
+			return -1;
+		}
+		done += n;
+	}
+	return done;
+}
+
+// Receives one complete frame from a blocking socket into *buf, growing it
+// (and *cap) as needed. Returns 1 with the type and payload length filled
+// in, 0 on EOF or -1 on error.
+static inline int FrameRecv (int fd, int *type, char **buf, size_t *cap, uint32_t *len)
+{
+	unsigned char hdr[FRAME_HDRLEN];
+	ssize_t n;
+	char *p;
+
+	if ((n = FrameReadn (fd, hdr, FRAME_HDRLEN)) <= 0)
+		return n;
+	if (FrameParse (hdr, FRAME_HDRLEN, type, len) != 1)
+	{
+		errno = EPROTO;
+		return -1;
+	}
+	if (*len > *cap)
+	{
+		if ((p = realloc (*buf, *len)) == NULL)
+			return -1;
+		*buf = p;
+		*cap = *len;
+	}
+	if (*len > 0 && FrameReadn (fd, *buf, *len) <= 0)
+		return -1;
+	return 1;
+}
+
+#endif
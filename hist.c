@@ -0,0 +1,81 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		hist.c -   Log-linear (HDR style) latency histogram
+--
+--	FUNCTIONS:		HistInit
+--				HistMerge
+--				HistPercentile
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See hist.h.
+---------------------------------------------------------------------------------------*/
+#include <string.h>
+#include "hist.h"
+
+// Highest value that falls into bucket i
+static uint64_t HistBucketHigh (int i)
+{
+	int k, shift;
+	uint64_t top;
+
+	if (i < HIST_FULL)
+		return i;
+	k = i - HIST_FULL;
+	shift = k / HIST_HALF + 1;
+	top = (uint64_t) (k % HIST_HALF) + HIST_HALF;
+	return ((top + 1) << shift) - 1;
+}
+
+void HistInit (struct Hist *h)
+{
+	memset (h, 0, sizeof (*h));
+}
+
+// Adds src to dst. src may be updated concurrently by its writer; each
+// counter is read once, so the result is a consistent-enough snapshot.
+void HistMerge (struct Hist *dst, const struct Hist *src)
+{
+	uint64_t max;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] += __atomic_load_n (&src->counts[i], __ATOMIC_RELAXED);
+	dst->count += __atomic_load_n (&src->count, __ATOMIC_RELAXED);
+	dst->sum += __atomic_load_n (&src->sum, __ATOMIC_RELAXED);
+	max = __atomic_load_n (&src->max, __ATOMIC_RELAXED);
+	if (max > dst->max)
+		dst->max = max;
+}
+
+// Returns the value below which pct percent of the recorded values fall
+// (the upper edge of its bucket, capped at the largest value seen).
+uint64_t HistPercentile (const struct Hist *h, double pct)
+{
+	uint64_t total = 0, rank, seen = 0, high;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		total += h->counts[i];
+	if (total == 0)
+		return 0;
+
+	rank = (uint64_t) (pct / 100.0 * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > total)
+		rank = total;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += h->counts[i];
+		if (seen >= rank)
+		{
+			high = HistBucketHigh (i);
+			return high < h->max ? high : h->max;
+		}
+	}
+	return h->max;
+}
@@ -0,0 +1,74 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		hist.h -   Log-linear (HDR style) latency histogram
+--
+--	FUNCTIONS:		HistInit
+--				HistRecord
+--				HistMerge
+--				HistPercentile
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Values (normally nanoseconds) are counted in buckets whose width grows
+--	with the value: every power of two is split into HIST_HALF linear
+--	sub-buckets, so any recorded value is reported within 1/HIST_HALF
+--	(about 1.6%) of its true value, from 1 ns up to the full 64 bit range,
+--	in a fixed HIST_BUCKETS array. Recording is O(1) and never allocates.
+--
+--	A histogram has a single writer. The counters are updated with relaxed
+--	atomic stores, which compile to plain stores, so another thread may read
+--	a (slightly stale) snapshot with HistMerge without any locking.
+---------------------------------------------------------------------------------------*/
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+
+#define HIST_SUB_BITS	7
+#define HIST_FULL	(1 << HIST_SUB_BITS)		// values below this are exact
+#define HIST_HALF	(1 << (HIST_SUB_BITS - 1))	// sub-buckets per power of two
+#define HIST_BUCKETS	(HIST_FULL + (64 - HIST_SUB_BITS) * HIST_HALF)
+
+struct Hist
+{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t counts[HIST_BUCKETS];
+};
+
+void HistInit (struct Hist *h);
+void HistMerge (struct Hist *dst, const struct Hist *src);
+uint64_t HistPercentile (const struct Hist *h, double pct);
+
+// Bucket index of value v
+static inline int HistIndex (uint64_t v)
+{
+	int shift;
+
+	if (v < HIST_FULL)
+		return (int) v;
+	shift = (63 - __builtin_clzll (v)) - (HIST_SUB_BITS - 1);
+	return HIST_FULL + (shift - 1) * HIST_HALF + (int) ((v >> shift) - HIST_HALF);
+}
+
+// Counts n occurrences of value v.
+static inline void HistRecordN (struct Hist *h, uint64_t v, uint64_t n)
+{
+	int i = HistIndex (v);
+
+	__atomic_store_n (&h->counts[i], h->counts[i] + n, __ATOMIC_RELAXED);
+	__atomic_store_n (&h->count, h->count + n, __ATOMIC_RELAXED);
+	__atomic_store_n (&h->sum, h->sum + v * n, __ATOMIC_RELAXED);
+	if (v > h->max)
+		__atomic_store_n (&h->max, v, __ATOMIC_RELAXED);
+}
+
+static inline void HistRecord (struct Hist *h, uint64_t v)
+{
+	HistRecordN (h, v, 1);
+}
+
+#endif
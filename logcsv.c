@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		logcsv.c -   Converts a binary connection log to svr.csv
+--
+--	PROGRAM:		logcsv
+--				gcc -Wall -ggdb -o logcsv logcsv.c
+--
+--	FUNCTIONS:		ConvertLog
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Usage: logcsv [-x] file... > svr.csv
+--	Reads logs written by the servers' -l option (connlog.c) and prints one
+--	line per connection in the layout of svr.csv:
+--
+--		client number, ip:port, seconds, requests, bytes
+--
+--	-x appends the seconds the server spent serving the connection and the
+--	number of the thread that served it.
+--
+--	A log cut short by a killed server may end in a partial record, which
+--	is ignored.
+---------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "connlog.h"
+
+int extended = 0;		// -x
+
+// Prints the records of the log at path; returns 0, or -1 if it is unreadable.
+static int ConvertLog (const char *path)
+{
+	struct ConnLogHeader hdr;
+	struct ConnRecord r;
+	struct in_addr ip;
+	FILE *fp;
+
+	if ((fp = fopen (path, "rb")) == NULL)
+	{
+		perror (path);
+		return -1;
+	}
+	if (fread (&hdr, sizeof (hdr), 1, fp) != 1 || memcmp (hdr.magic, CONNLOG_MAGIC, sizeof (hdr.magic)) != 0
+		|| hdr.version != CONNLOG_VERSION || hdr.record_size != sizeof (r))
+	{
+		fprintf (stderr, "%s: not a version %d connection log\n", path, CONNLOG_VERSION);
+		fclose (fp);
+		return -1;
+	}
+	while (fread (&r, sizeof (r), 1, fp) == 1)
+	{
+		ip.s_addr = r.ip;
+		printf ("%u, %s:%hu, %lf, %u, %lu", r.number, inet_ntoa (ip), r.port, r.secs, r.requests, r.bytes);
+		if (extended)
+			printf (", %lf, %hu", r.active_secs, r.thread);
+		putchar ('\n');
+	}
+	fclose (fp);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	int i, opt, rc = EXIT_SUCCESS;
+
+	while ((opt = getopt (argc, argv, "x")) != -1)
+	{
+		if (opt != 'x')
+		{
+			fprintf (stderr, "Usage: %s [-x] file...\n", argv[0]);
+			exit (EXIT_FAILURE);
+		}
+		extended = 1;
+	}
+	if (optind == argc)
+	{
+		fprintf (stderr, "Usage: %s [-x] file...\n", argv[0]);
+		exit (EXIT_FAILURE);
+	}
+	for (i = optind; i < argc; i++)
+		if (ConvertLog (argv[i]) == -1)
+			rc = EXIT_FAILURE;
+	exit (rc);
+}
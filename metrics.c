@@ -0,0 +1,218 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		metrics.c -   Per-thread server counters and stats listener
+--
+--	FUNCTIONS:		MetricsInit
+--				MetricsRusage
+--				MetricsStartServer
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See metrics.h. The report is plain text: a CSV table with one row per
+--	thread and a total row, followed by the merged latency percentiles.
+--	Counters are cumulative since start-up; sample twice and subtract to
+--	get rates.
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE	// RUSAGE_THREAD, sched_getcpu
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "metrics.h"
+
+#define LOAD(field)	__atomic_load_n (&(field), __ATOMIC_RELAXED)
+
+struct StatsServer
+{
+	int fd;
+	int count;
+	struct Metrics *const *threads;
+	uint64_t start;
+};
+
+void MetricsInit (struct Metrics *m)
+{
+	memset (m, 0, sizeof (*m));
+	m->cpu = -1;
+	HistInit (&m->latency);
+}
+
+// Publishes the calling thread's CPU time and context switches in m.
+void MetricsRusage (struct Metrics *m)
+{
+	struct rusage ru;
+
+	if (getrusage (RUSAGE_THREAD, &ru) == -1)
+		return;
+	METRIC_SET (m, cpu_user_us, ru.ru_utime.tv_sec * 1000000ULL + ru.ru_utime.tv_usec);
+	METRIC_SET (m, cpu_sys_us, ru.ru_stime.tv_sec * 1000000ULL + ru.ru_stime.tv_usec);
+	METRIC_SET (m, vcsw, ru.ru_nvcsw);
+	METRIC_SET (m, ivcsw, ru.ru_nivcsw);
+	METRIC_SET (m, cpu, sched_getcpu ());
+}
+
+// Copies the counters of src into dst (histogram excluded)
+static void Sample (struct Metrics *dst, const struct Metrics *src)
+{
+	dst->accepts = LOAD (src->accepts);
+	dst->closes = LOAD (src->closes);
+	dst->rejected = LOAD (src->rejected);
+	dst->accept_pauses = LOAD (src->accept_pauses);
+	dst->timeouts = LOAD (src->timeouts);
+	dst->messages = LOAD (src->messages);
+	dst->bytes_in = LOAD (src->bytes_in);
+	dst->bytes_out = LOAD (src->bytes_out);
+	dst->eagain_read = LOAD (src->eagain_read);
+	dst->eagain_write = LOAD (src->eagain_write);
+	dst->writes = LOAD (src->writes);
+	dst->partial_writes = LOAD (src->partial_writes);
+	dst->spliced = LOAD (src->spliced);
+	dst->syscalls = LOAD (src->syscalls);
+	dst->log_drops = LOAD (src->log_drops);
+	dst->offcpu_conns = LOAD (src->offcpu_conns);
+	dst->empty_polls = LOAD (src->empty_polls);
+	dst->hangups = LOAD (src->hangups);
+	dst->cpu_user_us = LOAD (src->cpu_user_us);
+	dst->cpu_sys_us = LOAD (src->cpu_sys_us);
+	dst->vcsw = LOAD (src->vcsw);
+	dst->ivcsw = LOAD (src->ivcsw);
+	dst->cpu = LOAD (src->cpu);
+}
+
+// CPU percent is of one core over secs; the total row has no CPU
+static void PrintRow (FILE *fp, const char *name, int id, const struct Metrics *m, double secs)
+{
+	if (name)
+		fprintf (fp, "%s", name);
+	else
+		fprintf (fp, "%d", id);
+	fprintf (fp, ", %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu, %.3f, %.3f, %lu, %.1f, %.1f, %.1f, %lu, %lu, %ld, %.0f, %lu, %lu, %lu\n",
+		m->accepts, m->accepts - m->closes, m->rejected, m->accept_pauses, m->timeouts, m->messages, m->bytes_in, m->bytes_out,
+		m->eagain_read, m->eagain_write, m->writes, m->partial_writes, m->spliced, m->syscalls,
+		m->messages ? (double) m->syscalls / m->messages : 0.0,
+		m->writes ? (double) m->messages / m->writes : 0.0, m->log_drops,
+		m->cpu_user_us / 1e3, m->cpu_sys_us / 1e3,
+		secs > 0 ? (m->cpu_user_us + m->cpu_sys_us) / 1e4 / secs : 0.0, m->vcsw, m->ivcsw,
+		m->cpu, secs > 0 ? m->messages / secs : 0.0, m->offcpu_conns, m->empty_polls, m->hangups);
+}
+
+static void Report (struct StatsServer *s, FILE *fp)
+{
+	struct Metrics one, total;
+	struct Hist *lat;
+	double secs = (MetricsNow () - s->start) / 1e9;
+	int i;
+
+	if ((lat = malloc (sizeof (struct Hist))) == NULL)
+		return;
+	HistInit (lat);
+	memset (&total, 0, sizeof (total));
+	total.cpu = -1;
+
+	fprintf (fp, "# uptime %.3f s, %d threads\n", secs, s->count);
+	fprintf (fp, "thread, accepts, active, rejected, accept_pauses, timeouts, messages, bytes_in, bytes_out, eagain_read, eagain_write, writes, partial_writes, spliced, syscalls, syscalls_per_msg, msgs_per_write, log_drops, cpu_user_ms, cpu_sys_ms, cpu_pct, vcsw, ivcsw, cpu, msgs_per_sec, offcpu_conns, empty_polls, hangups\n");
+	for (i = 0; i < s->count; i++)
+	{
+		Sample (&one, s->threads[i]);
+		PrintRow (fp, NULL, i, &one, secs);
+		HistMerge (lat, &s->threads[i]->latency);
+
+		total.accepts += one.accepts;
+		total.closes += one.closes;
+		total.rejected += one.rejected;
+		total.accept_pauses += one.accept_pauses;
+		total.timeouts += one.timeouts;
+		total.messages += one.messages;
+		total.bytes_in += one.bytes_in;
+		total.bytes_out += one.bytes_out;
+		total.eagain_read += one.eagain_read;
+		total.eagain_write += one.eagain_write;
+		total.writes += one.writes;
+		total.partial_writes += one.partial_writes;
+		total.spliced += one.spliced;
+		total.syscalls += one.syscalls;
+		total.log_drops += one.log_drops;
+		total.offcpu_conns += one.offcpu_conns;
+		total.empty_polls += one.empty_polls;
+		total.hangups += one.hangups;
+		total.cpu_user_us += one.cpu_user_us;
+		total.cpu_sys_us += one.cpu_sys_us;
+		total.vcsw += one.vcsw;
+		total.ivcsw += one.ivcsw;
+	}
+	PrintRow (fp, "total", 0, &total, secs);
+
+	fprintf (fp, "latency_us, count, mean, p50, p90, p99, p99.9, max\n");
+	fprintf (fp, "total, %lu, %.1f, %.1f, %.1f, %.1f, %.1f, %.1f\n", lat->count,
+		lat->count ? lat->sum / 1e3 / lat->count : 0.0,
+		HistPercentile (lat, 50) / 1e3, HistPercentile (lat, 90) / 1e3,
+		HistPercentile (lat, 99) / 1e3, HistPercentile (lat, 99.9) / 1e3, lat->max / 1e3);
+	free (lat);
+}
+
+static void *StatsLoop (void *arg)
+{
+	struct StatsServer *s = arg;
+	FILE *fp;
+	int fd;
+
+	while (1)
+	{
+		if ((fd = accept (s->fd, NULL, NULL)) == -1)
+		{
+			if (errno != EINTR)
+				perror ("stats accept");
+			continue;
+		}
+		if ((fp = fdopen (fd, "w")) == NULL)
+		{
+			close (fd);
+			continue;
+		}
+		Report (s, fp);
+		fclose (fp);
+	}
+	return NULL;
+}
+
+// Serves snapshots of threads[0..count-1] on 127.0.0.1:port from a
+// background thread. Returns 0, or -1 if the listener can't be set up.
+int MetricsStartServer (int port, struct Metrics *const *threads, int count)
+{
+	struct StatsServer *s;
+	struct sockaddr_in addr;
+	pthread_t tid;
+	int arg = 1;
+
+	if ((s = malloc (sizeof (*s))) == NULL)
+		return -1;
+	s->threads = threads;
+	s->count = count;
+	s->start = MetricsNow ();
+
+	if ((s->fd = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+		return -1;
+	setsockopt (s->fd, SOL_SOCKET, SO_REUSEADDR, &arg, sizeof (arg));
+
+	// Only reachable from the same host
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	addr.sin_port = htons (port);
+	if (bind (s->fd, (struct sockaddr *) &addr, sizeof (addr)) == -1 || listen (s->fd, 16) == -1)
+		return -1;
+
+	if (pthread_create (&tid, NULL, StatsLoop, s) != 0)
+		return -1;
+	pthread_detach (tid);
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		metrics.h -   Per-thread server counters and stats listener
+--
+--	FUNCTIONS:		MetricsInit
+--				MetricsRusage
+--				MetricsStartServer
+--				MetricsNow
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Every event-loop thread owns one struct Metrics and is its only writer.
+--	METRIC_ADD is a relaxed atomic store of the incremented value: on the
+--	hot path that is an ordinary add, with no lock prefix and no shared
+--	cache line, yet the stats thread can read the counters at any time
+--	without tearing.
+--
+--	getrusage (RUSAGE_THREAD) only reports on the calling thread, so each
+--	event-loop thread calls MetricsRusage itself now and then to publish
+--	its CPU time and context switches; the report shows the last sample.
+--	The sample also records the CPU the thread was running on, so with
+--	msgs_per_sec the report reads as per-core throughput.
+--
+--	MetricsStartServer starts a thread listening on a local TCP port. Every
+--	connection to it (e.g. "nc localhost 7010") receives a snapshot of all
+--	threads' counters plus their totals and the merged latency histogram,
+--	and is then closed.
+---------------------------------------------------------------------------------------*/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+#include "hist.h"
+
+struct Metrics
+{
+	uint64_t accepts;		// connections accepted
+	uint64_t closes;		// connections closed
+	uint64_t rejected;		// connections closed at accept for want of descriptors
+	uint64_t accept_pauses;		// times accepting stopped at the connection limit
+	uint64_t timeouts;		// connections closed by a handshake or idle timeout
+	uint64_t messages;		// frames echoed
+	uint64_t bytes_in;		// bytes read from clients
+	uint64_t bytes_out;		// bytes written to clients
+	uint64_t eagain_read;		// reads that found the socket empty
+	uint64_t eagain_write;		// writes that found the socket full
+	uint64_t writes;		// write system calls (sendmsg, splice out)
+	uint64_t partial_writes;	// writes that sent less than asked
+	uint64_t spliced;		// payload bytes relayed without a copy
+	uint64_t syscalls;		// socket and event system calls made
+	uint64_t log_drops;		// connection records lost to a full log ring
+	uint64_t offcpu_conns;		// closed connections whose packets came in on another CPU
+	uint64_t empty_polls;		// busy polls that found nothing
+	uint64_t hangups;		// connections closed on a hangup or error event
+
+	// Thread's own resource usage, sampled by the thread (MetricsRusage)
+	uint64_t cpu_user_us;
+	uint64_t cpu_sys_us;
+	uint64_t vcsw;			// voluntary context switches (blocking waits)
+	uint64_t ivcsw;			// involuntary ones (preempted)
+	int64_t cpu;			// CPU the thread last ran on, -1 before the first sample
+
+	struct Hist latency;		// ns from request read to reply written
+};
+
+#define METRIC_ADD(m, field, n)	__atomic_store_n (&(m)->field, (m)->field + (n), __ATOMIC_RELAXED)
+#define METRIC_SET(m, field, v)	__atomic_store_n (&(m)->field, (v), __ATOMIC_RELAXED)
+
+void MetricsInit (struct Metrics *m);
+void MetricsRusage (struct Metrics *m);
+int MetricsStartServer (int port, struct Metrics *const *threads, int count);
+
+// Monotonic time in nanoseconds
+static inline uint64_t MetricsNow (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif
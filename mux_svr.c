@@ -2,6 +2,7 @@
 --	SOURCE FILE:		mux_svr.c -   A simple multiplexed echo server using TCP
 --
 --	PROGRAM:		mux.exe
+--				gcc -Wall -ggdb -o mux mux_svr.c pool.c connlog.c tsc.c -lpthread
 --
 --	FUNCTIONS:		Berkeley Socket API
 --
@@ -12,6 +13,31 @@
 --				Added a proper read loop
 --				Added REUSEADDR
 --				Added fatal error wrapper function
+--				October 2026
+--				Replaced fixed BUFLEN requests with length-prefixed frames
+--				(frame.h) and an explicit close frame
+--				Client state lives in pooled structs (pool.c) kept in a
+--				compact array, instead of FD_SETSIZE parallel arrays
+--				Each read takes whatever the client has sent and all
+--				complete frames in it are echoed with one write
+--				Per-client summaries go to a binary log (-l, see
+--				connlog.c and logcsv.c) instead of stdout
+--				Time used is the client's lifetime on the monotonic
+--				clock instead of a difference of clock() values (process
+--				CPU time shared by all clients); service time is timed
+--				with the TSC (tsc.c)
+--				Admission control instead of exiting on "Too many
+--				clients": a client limit (-m) that pauses accepting with
+--				hysteresis, rejection of descriptors select can't watch,
+--				and a spare descriptor to reject connections on EMFILE
+--				Listens on a Unix-domain socket when given a path
+--				instead of a port (endpoint.h)
+--				Stops on SIGINT or SIGTERM and prints the clients
+--				accepted and rejected and the accept pauses
+--				Client sockets don't block: echoes the socket won't
+--				take wait in a per-client output buffer, written when
+--				select reports the socket writable, and a client with
+--				WBUF_HIGH unsent isn't read until it takes its echoes
 --
 --
 --	DESIGNERS:		Based on Richard Stevens Example, p165-166
@@ -24,178 +50,493 @@
 --	The program will accept TCP connections from multiple client machines.
 -- 	The program will read data from each client socket and simply echo it back.
 ---------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <time.h>
+#include "frame.h"
+#include "pool.h"
+#include "connlog.h"
+#include "tsc.h"
+#include "endpoint.h"
 
 #define SERVER_TCP_PORT 7001 // Default port
-# define BUFLEN 80 //Buffer length
+#define LOG_FILE "mux_svr.log" // Default connection log, "logcsv mux_svr.log" prints it
+# define READ_CHUNK 16384 //Receive buffer length, grows to fit the largest frame
 # define TRUE 1
-# define LISTENQ 5
+# define LISTENQ SOMAXCONN
+# define FD_RESERVE 16 // descriptors below FD_SETSIZE kept back from the client limit
+# define RESUME_PCT 90 // accepting resumes below this share of the limit
+# define WBUF_HIGH 262144 // stop reading a client while this much echo is unsent
 # define MAXLINE 4096
 
+// State of a connected client
+struct Client
+{
+    int sd;
+    struct in_addr ip; // ip address of the client
+    int portNum; // port number of the client
+    struct timespec startTime; // when the client was accepted (monotonic)
+    uint64_t active; // TSC ticks spent serving the client
+    int requestedGenerated;
+    size_t dataTransfered;
+    int clientNumber;
+    char *rbuf; // received bytes not yet echoed: at most one partial frame
+    size_t rcap, rlen;
+    char *wbuf; // echo bytes the socket hasn't taken yet, from woff to wlen
+    size_t wcap, woff, wlen;
+    int closing; // close frame seen: close once the echoes are out
+};
+
 // Function Prototypes
 static void SystemFatal(const char * );
+static int ReadFrames(struct Client *cl);
+static int QueueEcho(struct Client *cl, const char *buf, size_t len);
+static int FlushClient(struct Client *cl);
+static void Stop(int signo);
+
+static volatile sig_atomic_t stop = 0; // set by SIGINT and SIGTERM
 
 int main(int argc, char ** argv) {
-    int i, maxi, nready, bytes_to_read, arg;
-    int listen_sd, new_sd, sockfd, client_len, port, maxfd, client[FD_SETSIZE];
-
-    unsigned long ip_num[FD_SETSIZE]; // Saves ip address of the connected clients
-    int portNum[FD_SETSIZE]; // Saves port numbers of the connected clients
-    double startTimer[FD_SETSIZE]; // Saves start Timer of each of the clients
-    int requestedGenerated[FD_SETSIZE];
-    size_t dataTransfered[FD_SETSIZE];
-    int clientNumber[FD_SETSIZE];
+    int i, nready, arg, opt, alive;
+    int spare_fd, paused = 0, rejected = 0, pauses = 0;
+    int max_clients = FD_SETSIZE - FD_RESERVE;
+    int listen_sd, new_sd, sockfd, port, maxfd;
+    const char *unix_path = NULL; // Unix-domain endpoint in place of the port
+    socklen_t client_len;
+
+    struct Pool pool; // Client structs
+    struct Client ** client = NULL; // connected clients, packed at the front
+    struct Client * cl;
+    int nclients = 0, maxclients = 0;
     int numOfClients = 0;
-    clock_t end;
+    struct timespec end;
+    uint64_t start;
     struct sockaddr_in server, client_addr;
-    char * bp, buf[BUFLEN];
-    ssize_t n;
-    fd_set rset, allset;
-    char tmpc;
-    double cpu_time_used;
+    fd_set rset, allset, wset, wallset;
+    double time_used;
+    const char *log_path = LOG_FILE;
+    struct ConnLog *conn_log;
+    struct ConnRecord r;
+    struct sigaction act;
+    sigset_t block, orig;
 
-    switch (argc)
-	{
-	    case 1:
-	        port = SERVER_TCP_PORT; // Use the default port
-	        break;
-	    case 2:
-	        port = atoi(argv[1]); // Get user specified port
-	        break;
-	    default:
-	        fprintf(stderr, "Usage: %s [port]\n", argv[0]);
-	        exit(1);
+    while ((opt = getopt(argc, argv, "l:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'l':
+                log_path = optarg;
+                break;
+            case 'm':
+                max_clients = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-l log file] [-m max clients] [port | socket path]\n", argv[0]);
+                exit(1);
+        }
+    }
+    if (max_clients < 1 || max_clients > FD_SETSIZE - FD_RESERVE)
+        max_clients = FD_SETSIZE - FD_RESERVE; // select can't watch more
+    port = SERVER_TCP_PORT; // Use the default port
+    if (optind < argc)
+    {
+        if (EndpointIsPath(argv[optind]))
+            unix_path = argv[optind];
+        else
+            port = atoi(argv[optind]); // Get user specified port
     }
 
-    // Create a stream socket
-    if ((listen_sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
-        SystemFatal("Cannot Create Socket!");
+    // Service time is taken from the TSC
+    TscInit();
 
-    // set SO_REUSEADDR so port can be resused imemediately after exit, i.e., after CTRL-c
-    arg = 1;
-    if (setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, & arg, sizeof(arg)) == -1)
-        SystemFatal("setsockopt");
+    // The summary of every client is written out by a log thread
+    if ((conn_log = ConnLogOpen(log_path, 1)) == NULL)
+        SystemFatal(log_path);
 
-    // Bind an address to the socket
-    bzero((char * ) & server, sizeof(struct sockaddr_in));
-    server.sin_family = AF_INET;
-    server.sin_port = htons(port);
-    server.sin_addr.s_addr = htonl(INADDR_ANY); // Accept connections from any client
+    // A client that resets mid-echo must not kill the server
+    signal(SIGPIPE, SIG_IGN);
 
-    if (bind(listen_sd, (struct sockaddr * ) & server, sizeof(server)) == -1)
-        SystemFatal("bind error");
+    // Stop signals are taken only while waiting in pselect, so one can't
+    // slip in between the check and the wait
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &orig);
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = Stop;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGINT, &act, NULL) == -1 || sigaction(SIGTERM, &act, NULL) == -1)
+        SystemFatal("sigaction");
 
-    // Listen for connections
-    // queue up to LISTENQ connect requests
-    listen(listen_sd, LISTENQ);
+    // Given up on EMFILE so that the connection can be accepted and closed
+    if ((spare_fd = open("/dev/null", O_RDONLY)) == -1)
+        SystemFatal("open /dev/null");
+
+    if (unix_path)
+    {
+        if ((listen_sd = EndpointListenUnix(unix_path, 0)) == -1)
+            SystemFatal(unix_path);
+    }
+    else
+    {
+        // Create a stream socket
+        if ((listen_sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+            SystemFatal("Cannot Create Socket!");
+
+        // set SO_REUSEADDR so port can be resused imemediately after exit, i.e., after CTRL-c
+        arg = 1;
+        if (setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, & arg, sizeof(arg)) == -1)
+            SystemFatal("setsockopt");
+
+        // Bind an address to the socket
+        bzero((char * ) & server, sizeof(struct sockaddr_in));
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        server.sin_addr.s_addr = htonl(INADDR_ANY); // Accept connections from any client
+
+        if (bind(listen_sd, (struct sockaddr * ) & server, sizeof(server)) == -1)
+            SystemFatal("bind error");
+
+        // Listen for connections
+        // queue up to LISTENQ connect requests
+        listen(listen_sd, LISTENQ);
+    }
 
     maxfd = listen_sd; // initialize
-    maxi = -1; // index into client[] array
+    PoolInit(&pool, sizeof(struct Client));
 
-    for (i = 0; i < FD_SETSIZE; i++)
-        client[i] = -1; // -1 indicates available entry
     FD_ZERO( & allset);
+    FD_ZERO( & wallset); // clients with unsent echoes
     FD_SET(listen_sd, & allset);
 
-    while (TRUE)
+    while (!stop)
 	{
         rset = allset; // structure assignment
-        nready = select(maxfd + 1, & rset, NULL, NULL, NULL);
+        wset = wallset;
+        if ((nready = pselect(maxfd + 1, & rset, & wset, NULL, NULL, &orig)) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            SystemFatal("select");
+        }
 
         if (FD_ISSET(listen_sd, & rset)) // new client connection
         {
             client_len = sizeof(client_addr);
             if ((new_sd = accept(listen_sd, (struct sockaddr * ) & client_addr, & client_len)) == -1)
-                SystemFatal("accept error");
+            {
+                // Out of descriptors: take the connection with the spare
+                // one and close it, or the listener stays readable
+                if ((errno == EMFILE || errno == ENFILE) && spare_fd != -1)
+                {
+                    close(spare_fd);
+                    if ((new_sd = accept(listen_sd, NULL, NULL)) != -1)
+                    {
+                        close(new_sd);
+                        rejected++;
+                    }
+                    spare_fd = open("/dev/null", O_RDONLY);
+                }
+                else if (errno != EINTR && errno != ECONNABORTED)
+                    perror("accept");
+                continue;
+            }
 
             // printf(" Remote Address:  %s:%hu\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
 
+            // select can't watch descriptors past FD_SETSIZE: reject the client
+            if (new_sd >= FD_SETSIZE)
+			{
+                close(new_sd);
+                rejected++;
+                continue;
+            }
+
             //Accepted the a new client, increment to tell what client number they are.
             numOfClients += 1;
 
-            for (i = 0; i < FD_SETSIZE; i++)
-                if (client[i] < 0)
-				{
-                    client[i] = new_sd; // save descriptor
-                    portNum[i] = ntohs(client_addr.sin_port); // saves the client's port number
-                    ip_num[i] = inet_ntoa(client_addr.sin_addr); // save the client's ip address
-                    startTimer[i] = clock();
-                    clientNumber[i] = numOfClients;
-                    break;
-                }
-            if (i == FD_SETSIZE)
-			{
-                printf("Too many clients\n");
-                exit(1);
+            if (nclients == maxclients)
+            {
+                maxclients = maxclients ? maxclients * 2 : 64;
+                if ((client = realloc(client, maxclients * sizeof(*client))) == NULL)
+                    SystemFatal("realloc");
+            }
+            // One client must never hold up the others
+            if (fcntl(new_sd, F_SETFL, O_NONBLOCK) == -1)
+                SystemFatal("fcntl");
+            if ((cl = PoolAlloc(&pool)) == NULL)
+                SystemFatal("PoolAlloc");
+            cl->sd = new_sd; // save descriptor
+            cl->portNum = 0; // Unix-domain clients have no address
+            cl->ip.s_addr = 0;
+            if (client_addr.sin_family == AF_INET)
+            {
+                cl->portNum = ntohs(client_addr.sin_port); // saves the client's port number
+                cl->ip = client_addr.sin_addr; // save the client's ip address
             }
+            clock_gettime(CLOCK_MONOTONIC, &cl->startTime);
+            cl->clientNumber = numOfClients;
+            client[nclients++] = cl;
 
             FD_SET(new_sd, & allset); // add new descriptor to set
             if (new_sd > maxfd)
                 maxfd = new_sd; // for select
 
-            if (i > maxi)
-                maxi = i; // new max index in client[] array
+            // At the limit, leave new connections in the listen backlog
+            if (nclients >= max_clients && !paused)
+            {
+                FD_CLR(listen_sd, &allset);
+                paused = 1;
+                pauses++;
+                fprintf(stderr, "Accepting paused at %d clients (%d rejected so far)\n", nclients, rejected);
+            }
 
             if (--nready <= 0)
                 continue; // no more readable descriptors
         }
 
-        for (i = 0; i <= maxi; i++) // check all clients for data
+        for (i = 0; i < nclients; i++) // check all clients for data
         {
-            if ((sockfd = client[i]) < 0)
-                continue;
+            cl = client[i];
+            sockfd = cl->sd;
 
-            if (FD_ISSET(sockfd, & rset)) {
-                bp = buf;
-                bytes_to_read = BUFLEN;
-                while ((n = read(sockfd, bp, bytes_to_read)) > 0)
+            if (FD_ISSET(sockfd, & rset) || FD_ISSET(sockfd, & wset)) {
+                //Connection is closed on a close frame, EOF or an error
+                start = TscNow();
+                alive = 1;
+                if (FD_ISSET(sockfd, & wset))
                 {
-					bp += n;
-                    bytes_to_read -= n;
+                    alive = FlushClient(cl);
+                    nready--;
                 }
-
-                //Connection should be closed when reaching EOF instead of when text is done being sent
-                if (buf[0] != '\0')
+                if (alive && FD_ISSET(sockfd, & rset))
                 {
-                    // printf("%s\n", buf);
-                    requestedGenerated[i] += 1;
-                    dataTransfered[i] += sizeof(buf);
-                    write(sockfd, buf, BUFLEN); // echo to client
+                    alive = ReadFrames(cl);
+                    nready--;
                 }
+                cl->active += TscNow() - start;
+
+                // Watch for writability while echoes are unsent, and stop
+                // reading a client that doesn't take them
+                if (cl->wlen > 0)
+                    FD_SET(sockfd, &wallset);
+                else
+                    FD_CLR(sockfd, &wallset);
+                if (cl->closing || cl->wlen - cl->woff >= WBUF_HIGH)
+                    FD_CLR(sockfd, &allset);
                 else
+                    FD_SET(sockfd, &allset);
+                if (cl->closing && cl->wlen == 0)
+                    alive = 0;
+
+                if (!alive)
                 {
-                    end = clock();
-                    cpu_time_used = ((double) (end - startTimer[i])) / CLOCKS_PER_SEC;
-                    // printf("Connection #, Remote Address:Port Number, Time used, Requests Generated, Data Transfered\n");
-                    // printf("====================================================\n");
-                    printf("%d, %s:%hu, %lf, %d, %d\n", clientNumber[i], ip_num[i], portNum[i], cpu_time_used, requestedGenerated[i], dataTransfered[i]);
+                    clock_gettime(CLOCK_MONOTONIC, &end);
+                    time_used = (end.tv_sec - cl->startTime.tv_sec) + (end.tv_nsec - cl->startTime.tv_nsec) / 1e9;
+                    // Connection #, Remote Address:Port Number, Time used, Requests Generated, Data Transfered
+                    r.number = cl->clientNumber;
+                    r.ip = cl->ip.s_addr;
+                    r.port = cl->portNum;
+                    r.thread = 0;
+                    r.requests = cl->requestedGenerated;
+                    r.secs = time_used;
+                    r.active_secs = TscToNs(cl->active) / 1e9;
+                    r.bytes = cl->dataTransfered;
+                    r.spliced = 0;
+                    ConnLogPut(conn_log, 0, &r); // when full the record is dropped; its number is missing from the log
                     close(sockfd);
                     FD_CLR(sockfd, &allset);
-                    client[i] = -1;
-                    portNum[i] = 0;
-                    startTimer[i] = 0;
-                    requestedGenerated[i] = 0;
-                    dataTransfered[i] = 0;
-                    clientNumber[i] = -1;
+                    FD_CLR(sockfd, &wallset);
+                    free(cl->rbuf);
+                    free(cl->wbuf);
+                    PoolFree(&pool, cl);
+
+                    // Move the last client into the hole and look at it next
+                    client[i--] = client[--nclients];
+
+                    if (paused && nclients <= max_clients * RESUME_PCT / 100)
+                    {
+                        FD_SET(listen_sd, &allset);
+                        paused = 0;
+                        fprintf(stderr, "Accepting resumed at %d clients\n", nclients);
+                    }
                 }
 
-                if (--nready <= 0)
-                    break; // no more readable descriptors
+                if (nready <= 0)
+                    break; // no more ready descriptors
             }
         }
     }
+
+    fprintf(stderr, "Clients: %d accepted, %d rejected, %d accept pauses, %d connected\n",
+            numOfClients, rejected, pauses, nclients);
+    close(listen_sd);
+    if (unix_path)
+        unlink(unix_path);
+    ConnLogClose(conn_log); // writes out the summaries still queued
     return (0);
 }
 
+// Reads what the client has sent and echoes every complete frame with a
+// single write; the echo is the request bytes themselves. A partial frame
+// stays buffered for the next read. Returns 0 once the client is done (EOF,
+// a malformed frame or an error), 1 otherwise; after a close frame it sets
+// closing and the client is closed once its echoes are out.
+static int ReadFrames(struct Client *cl)
+{
+    size_t used = 0, need = 0;
+    uint32_t len;
+    int type, rc, open = 1;
+    ssize_t n;
+    char *p;
+
+    if (cl->rlen == cl->rcap)
+    {
+        cl->rcap = cl->rcap ? cl->rcap * 2 : READ_CHUNK;
+        if ((p = realloc(cl->rbuf, cl->rcap)) == NULL)
+            SystemFatal("realloc");
+        cl->rbuf = p;
+    }
+    n = read(cl->sd, cl->rbuf + cl->rlen, cl->rcap - cl->rlen);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 1;
+    if (n <= 0)
+        return 0;
+    cl->rlen += n;
+
+    while ((rc = FrameParse((unsigned char *)cl->rbuf + used, cl->rlen - used, &type, &len)) == 1)
+    {
+        if (type == FRAME_CLOSE)
+        {
+            open = 0;
+            break;
+        }
+        if (cl->rlen - used < FRAME_HDRLEN + len)
+        {
+            need = FRAME_HDRLEN + len;
+            break;
+        }
+        // printf("%s\n", cl->rbuf + used + FRAME_HDRLEN);
+        cl->requestedGenerated += 1;
+        cl->dataTransfered += len;
+        used += FRAME_HDRLEN + len;
+    }
+    // echo to client
+    if (used > 0 && QueueEcho(cl, cl->rbuf, used) == -1)
+        return 0;
+    if (rc == -1)
+        return 0;
+    if (!open)
+    {
+        cl->closing = 1;
+        return 1;
+    }
+
+    memmove(cl->rbuf, cl->rbuf + used, cl->rlen - used);
+    cl->rlen -= used;
+    if (need > cl->rcap)
+    {
+        // Room for all of a large frame
+        if ((p = realloc(cl->rbuf, need)) == NULL)
+            SystemFatal("realloc");
+        cl->rbuf = p;
+        cl->rcap = need;
+    }
+    else if (cl->rlen == 0 && cl->rcap > READ_CHUNK)
+    {
+        // Drop the buffer grown for a large frame once it is echoed
+        free(cl->rbuf);
+        cl->rbuf = NULL;
+        cl->rcap = 0;
+    }
+    return 1;
+}
+
+// Writes what the socket takes of buf and keeps the rest, after any echo
+// already waiting, in the client's output buffer. Returns -1 on error.
+static int QueueEcho(struct Client *cl, const char *buf, size_t len)
+{
+    size_t off = 0;
+    ssize_t n;
+    char *p;
+
+    while (cl->wlen == 0 && off < len)
+    {
+        n = send(cl->sd, buf + off, len - off, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        off += n;
+    }
+    if (off == len)
+        return 0;
+
+    // Slide the unsent bytes to the front, then grow to fit the rest
+    if (cl->woff > 0)
+    {
+        memmove(cl->wbuf, cl->wbuf + cl->woff, cl->wlen - cl->woff);
+        cl->wlen -= cl->woff;
+        cl->woff = 0;
+    }
+    if (cl->wlen + len - off > cl->wcap)
+    {
+        cl->wcap = cl->wlen + len - off > READ_CHUNK ? cl->wlen + len - off : READ_CHUNK;
+        if ((p = realloc(cl->wbuf, cl->wcap)) == NULL)
+            SystemFatal("realloc");
+        cl->wbuf = p;
+    }
+    memcpy(cl->wbuf + cl->wlen, buf + off, len - off);
+    cl->wlen += len - off;
+    return 0;
+}
+
+// Writes the client's unsent echoes once select says it is writable.
+// Returns 0 on error, 1 otherwise.
+static int FlushClient(struct Client *cl)
+{
+    ssize_t n;
+
+    while (cl->woff < cl->wlen)
+    {
+        n = send(cl->sd, cl->wbuf + cl->woff, cl->wlen - cl->woff, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        cl->woff += n;
+    }
+
+    // All out: drop the buffer until the socket refuses a write again
+    free(cl->wbuf);
+    cl->wbuf = NULL;
+    cl->wcap = cl->woff = cl->wlen = 0;
+    return 1;
+}
+
+// Ends the select loop
+static void Stop(int signo)
+{
+    stop = 1;
+}
+
 // Prints the error stored in errno and aborts the program.
 static void SystemFatal(const char * message)
 {
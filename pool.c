@@ -0,0 +1,140 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		pool.c -   Slab allocator for fixed-size objects
+--
+--	FUNCTIONS:		PoolInit
+--				PoolAlloc
+--				PoolFree
+--				PoolDestroy
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See pool.h. Each slab starts with a PoolSlab header followed by its
+--	objects; free objects are chained through their first word. A slab with
+--	free objects sits on the pool's partial list; a full slab is off the list
+--	until one of its objects is freed. An empty slab is released unless it
+--	is the only partial slab left, which avoids thrashing at a boundary.
+---------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+#define POOL_ALIGN	16
+
+struct PoolSlab
+{
+	struct PoolSlab *next, *prev;	// partial list links
+	void *free;			// first free object
+	size_t live;			// objects in use
+};
+
+#define SLAB_OF(obj)	((struct PoolSlab *) ((uintptr_t) (obj) & ~(uintptr_t) (POOL_SLAB_SIZE - 1)))
+#define SLAB_HDR	((sizeof (struct PoolSlab) + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1))
+
+static void Unlink (struct Pool *pool, struct PoolSlab *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		pool->partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	slab->next = slab->prev = NULL;
+}
+
+static void Push (struct Pool *pool, struct PoolSlab *slab)
+{
+	slab->prev = NULL;
+	slab->next = pool->partial;
+	if (pool->partial)
+		pool->partial->prev = slab;
+	pool->partial = slab;
+}
+
+// Sets up an empty pool for objects of obj_size bytes.
+void PoolInit (struct Pool *pool, size_t obj_size)
+{
+	memset (pool, 0, sizeof (*pool));
+	if (obj_size < sizeof (void *))
+		obj_size = sizeof (void *);
+	pool->obj_size = (obj_size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+	pool->per_slab = (POOL_SLAB_SIZE - SLAB_HDR) / pool->obj_size;
+	if (pool->per_slab == 0)
+	{
+		fprintf (stderr, "PoolInit: objects of %zu bytes don't fit a slab\n", obj_size);
+		exit (EXIT_FAILURE);
+	}
+}
+
+// Returns a zeroed object, or NULL if memory is exhausted.
+void *PoolAlloc (struct Pool *pool)
+{
+	struct PoolSlab *slab = pool->partial;
+	char *obj;
+	size_t i;
+
+	if (slab == NULL)
+	{
+		if ((slab = aligned_alloc (POOL_SLAB_SIZE, POOL_SLAB_SIZE)) == NULL)
+			return NULL;
+		slab->live = 0;
+		slab->free = NULL;
+		// Chain the objects so the lowest addresses are handed out first
+		for (i = pool->per_slab; i > 0; i--)
+		{
+			obj = (char *) slab + SLAB_HDR + (i - 1) * pool->obj_size;
+			*(void **) obj = slab->free;
+			slab->free = obj;
+		}
+		Push (pool, slab);
+		pool->slabs++;
+	}
+
+	obj = slab->free;
+	slab->free = *(void **) obj;
+	slab->live++;
+	pool->live++;
+	if (slab->free == NULL)
+		Unlink (pool, slab);	// full
+
+	memset (obj, 0, pool->obj_size);
+	return obj;
+}
+
+// Returns obj to its slab, releasing the slab once it is empty.
+void PoolFree (struct Pool *pool, void *obj)
+{
+	struct PoolSlab *slab = SLAB_OF (obj);
+
+	if (slab->free == NULL)
+		Push (pool, slab);	// was full
+	*(void **) obj = slab->free;
+	slab->free = obj;
+	slab->live--;
+	pool->live--;
+
+	if (slab->live == 0 && (slab->next || slab->prev))
+	{
+		Unlink (pool, slab);
+		free (slab);
+		pool->slabs--;
+	}
+}
+
+// Frees the pool's partial slabs. Objects still in use are leaked with
+// their (full) slabs, so call this only once every object is freed.
+void PoolDestroy (struct Pool *pool)
+{
+	struct PoolSlab *slab;
+
+	while ((slab = pool->partial) != NULL)
+	{
+		Unlink (pool, slab);
+		free (slab);
+	}
+	pool->slabs = 0;
+}
@@ -0,0 +1,44 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		pool.h -   Slab allocator for fixed-size objects
+--
+--	FUNCTIONS:		PoolInit
+--				PoolAlloc
+--				PoolFree
+--				PoolDestroy
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	The servers keep their per-connection structs in a Pool instead of static
+--	arrays indexed by fd. Objects are carved out of POOL_SLAB_SIZE slabs that
+--	are allocated as connections arrive and released again once every object
+--	in them is free, so memory follows the number of live connections.
+--	Alloc and free are O(1): the owning slab of an object is found by masking
+--	its address. A Pool is not thread safe; each worker owns its own.
+---------------------------------------------------------------------------------------*/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_SLAB_SIZE	65536	// bytes per slab, also its alignment
+
+struct PoolSlab;
+
+struct Pool
+{
+	size_t obj_size;
+	size_t per_slab;		// objects per slab
+	struct PoolSlab *partial;	// slabs with at least one free object
+	size_t live;			// objects handed out
+	size_t slabs;			// slabs allocated
+};
+
+void PoolInit (struct Pool *pool, size_t obj_size);
+void *PoolAlloc (struct Pool *pool);
+void PoolFree (struct Pool *pool, void *obj);
+void PoolDestroy (struct Pool *pool);
+
+#endif
@@ -0,0 +1,282 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		svrstat.c -   Summarizes server result logs (svr.csv)
+--
+--	PROGRAM:		svrstat
+--				gcc -Wall -O2 -o svrstat svrstat.c hist.c
+--
+--	FUNCTIONS:		ParseUint
+--				ParseSeconds
+--				ScanLog
+--				Report
+--				SummarizeLog
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Usage: svrstat [-d run seconds] [-o summary.csv] file...
+--	Reads result files in the layout of svr.csv and svr.txt (client number,
+--	ip:port, seconds, requests, bytes; logcsv -x columns are ignored) and
+--	writes a CSV with one row per file:
+--
+--		file		the file summarized
+--		conns		connections, i.e. lines parsed
+--		bad_lines	lines that didn't parse, skipped
+--		requests, bytes	totals over all connections
+--		max_s		the longest connection's seconds
+--		requests_per_s, mb_per_s
+--				totals over the run time (see below)
+--		secs_p50 .. secs_max
+--				connection lifetime percentiles, in seconds
+--		req_min .. req_max, bytes_min .. bytes_max
+--				requests and bytes per connection
+--		fair_bytes, fair_rate
+--				Jain's fairness index, (sum x)^2 / (n * sum x^2), of
+--				the bytes each client moved and of its bytes per
+--				second: 1 when every client got the same share, 1/n
+--				when one client got everything
+--
+--	Each file is mapped and parsed in a single sequential pass with no
+--	allocation and no stdio per line. Durations, requests and bytes are
+--	counted in HDR histograms (hist.h), so the percentiles are within 1.6%
+--	whatever the number of connections and the memory use is fixed.
+--
+--	The logs hold each connection's lifetime but not when it started, so
+--	by default the run is taken to last as long as its longest connection
+--	(max_s), which holds when every client starts at once. Clients opened
+--	on a ramp or at random (tcp_clnt -a) make the run longer than that, so
+--	the rates come out too high; give the run's wall-clock time with -d to
+--	divide by it instead.
+---------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hist.h"
+
+struct Summary
+{
+	uint64_t conns;
+	uint64_t bad_lines;
+	uint64_t requests;
+	uint64_t bytes;
+	double max_secs;
+	uint64_t min_requests;
+	uint64_t min_bytes;
+	double sum_bytes_sq;		// for the fairness indexes
+	double sum_rate;
+	double sum_rate_sq;
+	uint64_t rated;			// connections with a nonzero duration
+	struct Hist usecs;		// connection durations, microseconds
+	struct Hist reqs;
+	struct Hist byts;
+};
+
+static struct Summary sum;
+static double run_secs = 0;		// -d, 0 for max_secs
+
+// Parses an unsigned decimal after optional blanks; returns the position
+// after it, or NULL if there are no digits.
+static const char *ParseUint (const char *p, const char *end, uint64_t *v)
+{
+	uint64_t n = 0;
+	const char *start;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	for (start = p; p < end && *p >= '0' && *p <= '9'; p++)
+		n = n * 10 + (*p - '0');
+	if (p == start)
+		return NULL;
+	*v = n;
+	return p;
+}
+
+// Parses a fixed-point number of seconds ("0.339417") into microseconds,
+// rounding away the digits below them.
+static const char *ParseSeconds (const char *p, const char *end, uint64_t *usecs)
+{
+	uint64_t frac = 0;
+	int digits = 0;
+
+	if ((p = ParseUint (p, end, usecs)) == NULL)
+		return NULL;
+	*usecs *= 1000000;
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+			if (digits < 7)
+			{
+				frac = frac * 10 + (*p - '0');
+				digits++;
+			}
+		while (digits < 7)
+		{
+			frac *= 10;
+			digits++;
+		}
+		*usecs += (frac + 5) / 10;
+	}
+	return p;
+}
+
+// Expects a comma after optional blanks.
+static inline const char *Comma (const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p < end && *p == ',' ? p + 1 : NULL;
+}
+
+// Adds the lines of [p, end) to sum.
+static void ScanLog (const char *p, const char *end)
+{
+	uint64_t number, usecs, requests, bytes;
+	const char *q, *nl;
+	double secs, rate;
+
+	for (; p < end; p = nl + 1)
+	{
+		if ((nl = memchr (p, '\n', end - p)) == NULL)
+			nl = end;
+		if (nl == p || (nl == p + 1 && *p == '\r'))
+			continue;
+
+		// number, address (skipped), seconds, requests, bytes[, ...]
+		if ((q = ParseUint (p, nl, &number)) == NULL || (q = Comma (q, nl)) == NULL
+			|| (q = memchr (q, ',', nl - q)) == NULL
+			|| (q = ParseSeconds (q + 1, nl, &usecs)) == NULL || (q = Comma (q, nl)) == NULL
+			|| (q = ParseUint (q, nl, &requests)) == NULL || (q = Comma (q, nl)) == NULL
+			|| (q = ParseUint (q, nl, &bytes)) == NULL)
+		{
+			sum.bad_lines++;
+			continue;
+		}
+
+		secs = usecs / 1e6;
+		if (sum.conns == 0 || requests < sum.min_requests)
+			sum.min_requests = requests;
+		if (sum.conns == 0 || bytes < sum.min_bytes)
+			sum.min_bytes = bytes;
+		if (secs > sum.max_secs)
+			sum.max_secs = secs;
+		sum.conns++;
+		sum.requests += requests;
+		sum.bytes += bytes;
+		sum.sum_bytes_sq += (double) bytes * bytes;
+		if (usecs > 0)
+		{
+			rate = bytes / secs;
+			sum.sum_rate += rate;
+			sum.sum_rate_sq += rate * rate;
+			sum.rated++;
+		}
+		HistRecord (&sum.usecs, usecs);
+		HistRecord (&sum.reqs, requests);
+		HistRecord (&sum.byts, bytes);
+	}
+}
+
+// Jain's fairness index of n values with the given sum and sum of squares
+static double Jain (double total, double squares, uint64_t n)
+{
+	return squares > 0 ? total * total / (n * squares) : 1.0;
+}
+
+static void Report (FILE *out, const char *path)
+{
+	double mb_per_s = 0, req_per_s = 0;
+	double secs = run_secs > 0 ? run_secs : sum.max_secs;
+
+	if (secs > 0)
+	{
+		req_per_s = sum.requests / secs;
+		mb_per_s = sum.bytes / secs / 1e6;
+	}
+	fprintf (out, "%s,%lu,%lu,%lu,%lu,%.6f,%.0f,%.2f,%.6f,%.6f,%.6f,%.6f,"
+		"%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.4f,%.4f\n",
+		path, sum.conns, sum.bad_lines, sum.requests, sum.bytes, sum.max_secs, req_per_s, mb_per_s,
+		HistPercentile (&sum.usecs, 50) / 1e6, HistPercentile (&sum.usecs, 90) / 1e6,
+		HistPercentile (&sum.usecs, 99) / 1e6, sum.usecs.max / 1e6,
+		sum.min_requests, HistPercentile (&sum.reqs, 50), HistPercentile (&sum.reqs, 99), sum.reqs.max,
+		sum.min_bytes, HistPercentile (&sum.byts, 50), HistPercentile (&sum.byts, 99), sum.byts.max,
+		sum.conns ? Jain ((double) sum.bytes, sum.sum_bytes_sq, sum.conns) : 0,
+		sum.rated ? Jain (sum.sum_rate, sum.sum_rate_sq, sum.rated) : 0);
+}
+
+// Summarizes the file at path onto out; returns 0, or -1 if it is unreadable.
+static int SummarizeLog (FILE *out, const char *path)
+{
+	struct stat st;
+	char *map = NULL;
+	int fd;
+
+	if ((fd = open (path, O_RDONLY)) == -1 || fstat (fd, &st) == -1)
+	{
+		perror (path);
+		if (fd != -1)
+			close (fd);
+		return -1;
+	}
+	memset (&sum, 0, sizeof (sum));
+	if (st.st_size > 0)
+	{
+		if ((map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+		{
+			perror (path);
+			close (fd);
+			return -1;
+		}
+		madvise (map, st.st_size, MADV_SEQUENTIAL);
+		ScanLog (map, map + st.st_size);
+		munmap (map, st.st_size);
+	}
+	close (fd);
+	Report (out, path);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	FILE *out = stdout;
+	int i, opt, rc = EXIT_SUCCESS;
+
+	while ((opt = getopt (argc, argv, "d:o:")) != -1)
+	{
+		if (opt == 'd')
+			run_secs = atof (optarg);
+		else if (opt != 'o')
+		{
+			fprintf (stderr, "Usage: %s [-d run seconds] [-o summary.csv] file...\n", argv[0]);
+			exit (EXIT_FAILURE);
+		}
+		else if ((out = fopen (optarg, "w")) == NULL)
+		{
+			perror (optarg);
+			exit (EXIT_FAILURE);
+		}
+	}
+	if (optind == argc)
+	{
+		fprintf (stderr, "Usage: %s [-d run seconds] [-o summary.csv] file...\n", argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	fprintf (out, "file,conns,bad_lines,requests,bytes,max_s,requests_per_s,mb_per_s,"
+		"secs_p50,secs_p90,secs_p99,secs_max,req_min,req_p50,req_p99,req_max,"
+		"bytes_min,bytes_p50,bytes_p99,bytes_max,fair_bytes,fair_rate\n");
+	for (i = optind; i < argc; i++)
+		if (SummarizeLog (out, argv[i]) == -1)
+			rc = EXIT_FAILURE;
+	if (fclose (out) != 0)
+	{
+		perror ("svrstat");
+		rc = EXIT_FAILURE;
+	}
+	exit (rc);
+}
@@ -2,6 +2,7 @@
 --	SOURCE FILE:		tcp_clnt.c - A simple TCP client program.
 --
 --	PROGRAM:		tclnt.exe
+--				gcc -Wall -ggdb -o tclnt tcp_clnt.c hist.c corpus.c -lpthread -lm
 --
 --	FUNCTIONS:		Berkeley Socket API
 --
@@ -11,6 +12,32 @@
 --				January 2005
 --				Modified the read loop to use fgets.
 --				While loop is based on the buffer length
+--				October 2026
+--				Sends length-prefixed frames (frame.h) and ends the
+--				session with a close frame. Added -s to send the file
+--				in chunks of a given size instead of line by line.
+--				Added an event-driven mode (-e): a few threads each
+--				run an epoll loop over thousands of non-blocking
+--				connections at a set request rate (-r) for a set
+--				duration (-d).
+--				Round-trip times of every request go into latency
+--				histograms (hist.c), reported as CSV at the end.
+--				Added a pipeline depth (-P): each client keeps up to
+--				that many requests in flight.
+--				Messages come from a corpus (corpus.c) built once and
+--				shared by all clients instead of each thread opening
+--				alice.txt: another file (-f) or generated messages
+--				with a size distribution (-g, -n).
+--				Added a UDP mode (-u) to event mode: requests are
+--				datagrams sent and received in batches with sendmmsg
+--				and recvmmsg.
+--				Connects to a Unix-domain socket when given a path
+--				instead of a host (endpoint.h)
+--				The host is resolved once for all clients. Thread
+--				mode clients connect in parallel, without the global
+--				lock, and both modes open their connections on an
+--				arrival schedule (-a). Thread mode prints a summary
+--				instead of every message unless -v is given.
 --
 --
 --	DESIGNERS:		Aman Abdulla
@@ -23,181 +50,1307 @@
 --	IP address. After the connection has been established the user will be
 -- 	prompted for date. The date string is then sent to the server and the
 -- 	response (echo) back from the server is displayed.
+--
+--	In event-driven mode nothing is displayed per message. The clients are
+--	split over the loop threads; each connection keeps up to the pipeline
+--	depth of requests in flight, sent at its own fixed rate (or as soon as
+--	an echo frees a slot when no rate is given), and a summary is printed
+--	at the end.
+--	Raise the descriptor limit (ulimit -n) for large connection counts.
+--	In thread mode the sockets block, so keep depth * message size within
+--	the socket buffers or client and server can stall writing to each other.
+--
+--	Both modes finish with a latency table in microseconds. The "rtt" row
+--	times each request from its send to the end of its echo. With a rate
+--	(-r) the client is open loop and a slow echo delays the requests queued
+--	behind it; timing those from the moment they were sent would hide that
+--	wait (coordinated omission), so the "intended" row times every request
+--	from when its schedule said it should go out.
+--
+--	With -u batch the event mode clients speak UDP to epoll_svr -u. The
+--	clients of a loop thread share one connected datagram socket; each
+--	request is a datagram holding a tag (client and sequence number) and
+--	a corpus frame, and the server echoes it whole. The requests due on
+--	all of a thread's clients go out batch at a time with sendmmsg, and
+--	echoes come back batch at a time with recvmmsg. An echo still missing
+--	after UDP_LOSS_NS, or overtaken by a later one, is counted as lost and
+--	frees its slot. The summary adds the datagrams lost and the average
+--	batch each system call moved.
+--
+--	Connections are opened on the arrival schedule given with -a: "burst"
+--	(the default) opens them all at once, "linear:S" spreads them evenly
+--	over S seconds and "poisson:R" opens them at random at an average of R
+--	per second, as independent users would arrive. The run time (-d)
+--	includes the ramp. The "connect" latency row times each connection
+--	from connect() to established. UDP clients have no connection and all
+--	start at once. Thread mode displays the messages only with -v; the
+--	output would otherwise throttle the clients.
+--
+--	A host containing a '/' is the path of a Unix-domain socket served on
+--	this host (see endpoint.h), which takes no port: "tcp_clnt -e 2
+--	/tmp/echo.sock 1000". Results are reported as for TCP.
 ---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE // sendmmsg, recvmmsg
 #include <pthread.h>
+#include <math.h>
 #include <stdio.h>
 #include <netdb.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-
-// Function Prototypes
-void *ClntConnection(void *data);
+#include "frame.h"
+#include "hist.h"
+#include "corpus.h"
+#include "endpoint.h"
 
 #define SERVER_TCP_PORT 7000 // Default port
-#define BUFLEN 80           // Buffer length
+#define CORPUS_FILE "alice.txt" // Default corpus
+#define CORPUS_COUNT 1024   // Default number of generated messages
+#define EV_MAX_EVENTS 256   // epoll events handled per wakeup
+#define EV_DURATION 10      // Default event mode run time in seconds
+#define UDP_BATCH_MAX 1024  // datagrams per sendmmsg/recvmmsg (UIO_MAXIOV)
+#define UDP_TAGLEN 8        // client index and sequence number ahead of the frame
+#define UDP_MAXLEN 65507    // largest UDP payload over IPv4
+#define UDP_LOSS_NS 1000000000ULL // an echo this late is counted as lost
+#define UDP_SWEEP_NS 100000000ULL // how often to look for lost echoes
+#define UDP_SOCKBUF 4194304 // socket buffers asked for, capped by the kernel
+#define CLNT_STACK 262144   // thread mode client stack; thousands of threads add up
+#define CLOSE_WAIT_NS 1000000000ULL // how long a closing client waits for the server to close
+
+// Event mode connection states
+#define LC_CONNECTING 0
+#define LC_OPEN 1
 
 //Struct
 struct ConArgs
 {
-    int port;
     char *host;
+    struct sockaddr *server; // resolved once for every client
+    socklen_t server_len;
+    const struct Corpus *corpus; // messages every client sends in turn
+    int text;               // messages are lines
+    int verbose;            // display every message
+    int depth;              // requests kept in flight per client
+};
+
+// Address of the server, IPv4 or Unix-domain
+union ServerAddr
+{
+    struct sockaddr sa;
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+};
+
+// One thread mode client
+struct ClntThread
+{
+    pthread_t thread;
+    struct ConArgs *args;
+    uint64_t connect_at;    // when to connect (ns), from the arrival schedule
+
+    // Results
+    int connected;
+    int errors;
+    uint64_t connect_ns;    // connect() to established
+    uint64_t requests;
+    uint64_t bytes;
 };
 
+// One event mode connection. It sends the corpus messages in turn, so the
+// queued requests are always a run of consecutive frames of the corpus.
+struct LoadConn
+{
+    int fd;
+    int state;
+    int heap;               // position in the send schedule, -1 if not in it
+    uint64_t next_send;     // when the next request is due (ns)
+    size_t next;            // corpus message to queue next
+    size_t oldest;          // corpus message of the oldest request in flight
+    size_t wpos;            // offset in the corpus frames of the next byte to send
+    size_t wleft;           // request bytes queued but not yet sent
+    size_t rgot;            // bytes received of the oldest request's echo
+    int head;               // ring slot of the oldest request in flight
+    int inflight;           // requests sent (or queued) and not yet echoed
+    uint64_t *sent_at;      // ring of depth send times
+    uint64_t *intended;     // ring of depth scheduled send times
+    uint32_t seq;           // UDP: sequence number of the next request
+};
+
+// One event mode loop thread and its share of the connections
+struct LoadThread
+{
+    pthread_t thread;
+    struct sockaddr *server;
+    socklen_t server_len;
+    int conns;
+    uint64_t interval;      // ns between requests on a connection, 0 = back to back
+    uint64_t start;         // when the run started (ns)
+    uint64_t end;           // when to stop (ns)
+    const uint64_t *arrivals; // connect times after start (ns), every stride'th is ours
+    int stride;
+    const struct Corpus *corpus;
+    int depth;              // requests kept in flight per connection
+    int udp_batch;          // UDP mode: datagrams per system call, 0 for TCP
+    unsigned int seed;
+
+    struct LoadConn *conn;
+    struct LoadConn **heap; // idle connections, earliest next_send first
+    int nheap;
+    int started;            // connections opened so far
+
+    // Results
+    uint64_t connected;
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t lost;          // UDP: requests whose echo never came
+    uint64_t sent;          // UDP: datagrams sent
+    uint64_t sends;         // UDP: sendmmsg calls
+    uint64_t received;      // UDP: datagrams received
+    uint64_t receives;      // UDP: recvmmsg calls that returned datagrams
+    struct Hist connect;
+    struct Hist rtt;
+    struct Hist intended;
+};
+
+// Function Prototypes
+void *ClntConnection(void *data);
+static int ClntSession(struct ClntThread *ct, int sd, struct Hist *hist);
+static int DrainInput(int fd, char *buf, size_t len);
+static void AwaitClose(int sd);
+static uint64_t NowNs(void);
+static void SleepUntil(uint64_t ns);
+static socklen_t ResolveServer(const char *host, int port, union ServerAddr *server);
+static int ArrivalSchedule(const char *spec, int n, uint64_t *at);
+static void PrintLatency(const char *name, const struct Hist *h);
+static int RunEventMode(struct ConArgs *args, int loops, int clients, double rate, int duration, int udp_batch,
+                        const uint64_t *arrivals);
+static void *LoadLoop(void *data);
+static void *UdpLoop(void *data);
+
 pthread_mutex_t lock;
+struct Hist handshake;      // connect times of all clients
+struct Hist rtt;            // round-trip times of all clients, merged at their end
+struct Hist intended;       // event mode, timed from the scheduled send
 
 int main(int argc, char **argv)
 {
-    int i, n, bytes_to_read;
-    int sd, port;
-    struct hostent *hp;
-    struct sockaddr_in server;
+    int i, opt;
+    int port;
     struct ConArgs connectionArgs;
     struct ConArgs *argPT;
+    union ServerAddr server;
+    struct ClntThread *clnt;
+    pthread_attr_t attr;
+    uint64_t start, *arrivals, connected = 0, requests = 0, bytes = 0, errors = 0;
+    double secs;
 
-    char *host, *bp, rbuf[BUFLEN], sbuf[BUFLEN], **pptr, *sptr;
-    char str[16];
+    char *host;
     int numOfThreads = 1;
+    size_t size = 0, count = CORPUS_COUNT;
+    int loops = 0, duration = EV_DURATION, depth = 1, udp_batch = 0, verbose = 0;
+    double rate = 0;
+    char *file = CORPUS_FILE, *spec = NULL, *arrival = "burst";
+    struct Corpus corpus;
+
+    while ((opt = getopt(argc, argv, "s:e:r:d:P:f:g:n:u:a:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            size = strtoul(optarg, NULL, 10);
+            if (size == 0 || size > FRAME_MAXLEN)
+            {
+                fprintf(stderr, "Message size must be between 1 and %u\n", FRAME_MAXLEN);
+                exit(1);
+            }
+            break;
+        case 'e':
+            loops = atoi(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'P':
+            if ((depth = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "Pipeline depth must be at least 1\n");
+                exit(1);
+            }
+            break;
+        case 'f':
+            file = optarg;
+            break;
+        case 'g':
+            spec = optarg;
+            break;
+        case 'n':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        case 'u':
+            udp_batch = atoi(optarg);
+            if (udp_batch < 1 || udp_batch > UDP_BATCH_MAX)
+            {
+                fprintf(stderr, "UDP batch must be between 1 and %d\n", UDP_BATCH_MAX);
+                exit(1);
+            }
+            break;
+        case 'a':
+            arrival = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f file [-s message size] | -g size distribution [-n messages]] [-P pipeline depth] [-a burst | linear:seconds | poisson:connects/s] [-v] [-e loop threads [-r requests/s per client] [-d seconds] [-u udp batch]] {host [port] | socket path} [number of clients]\n", argv[0]);
+            exit(1);
+        }
+    }
 
-    switch (argc)
+    switch (argc - optind)
     {
+    case 1:
+        host = argv[optind]; // Host name
+        port = SERVER_TCP_PORT;
+        break;
     case 2:
-        host = argv[1]; // Host name
+        host = argv[optind];
         port = SERVER_TCP_PORT;
+        if (EndpointIsPath(host))
+            numOfThreads = atoi(argv[optind + 1]); // a socket path takes no port
+        else
+            port = atoi(argv[optind + 1]); // User specified port
         break;
     case 3:
-        host = argv[1];
-        port = atoi(argv[2]); // User specified port
-        break;
-    case 4:
-        host = argv[1];
-        port = atoi(argv[2]);
-        numOfThreads = atoi(argv[3]);
+        host = argv[optind];
+        port = atoi(argv[optind + 1]);
+        numOfThreads = atoi(argv[optind + 2]);
         break;
     default:
-        fprintf(stderr, "Usage: %s host [port] [number of threads]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-f file [-s message size] | -g size distribution [-n messages]] [-P pipeline depth] [-a burst | linear:seconds | poisson:connects/s] [-v] [-e loop threads [-r requests/s per client] [-d seconds] [-u udp batch]] {host [port] | socket path} [number of clients]\n", argv[0]);
         exit(1);
     }
+    // One read-only copy of the messages for every client
+    if ((spec ? CorpusGenerate(&corpus, spec, count) : CorpusLoad(&corpus, file, size)) == -1)
+    {
+        fprintf(stderr, "Can't build the corpus from %s: %s\n", spec ? spec : file, strerror(errno));
+        exit(1);
+    }
+
+    // Resolved once for every client, and every connect time drawn up front
+    if ((arrivals = malloc((numOfThreads > 0 ? numOfThreads : 1) * sizeof(uint64_t))) == NULL)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    if (ArrivalSchedule(arrival, numOfThreads, arrivals) == -1)
+    {
+        fprintf(stderr, "Arrival schedule must be burst, linear:seconds or poisson:connects/s\n");
+        exit(1);
+    }
+
     connectionArgs.host = host;
-    connectionArgs.port = port;
+    connectionArgs.server_len = ResolveServer(host, port, &server);
+    connectionArgs.server = &server.sa;
+    connectionArgs.corpus = &corpus;
+    connectionArgs.text = spec == NULL && size == 0;
+    connectionArgs.verbose = verbose;
+    connectionArgs.depth = depth;
     argPT = &connectionArgs;
 
+    if (udp_batch > 0 && (loops == 0 || EndpointIsPath(host) || UDP_TAGLEN + FRAME_HDRLEN + corpus.max_len > UDP_MAXLEN))
+    {
+        fprintf(stderr, "UDP mode needs event mode (-e), a host and messages of at most %d bytes\n",
+                UDP_MAXLEN - UDP_TAGLEN - FRAME_HDRLEN);
+        exit(1);
+    }
+
+    // Event-driven mode: numOfThreads clients over a few epoll loops
+    if (loops > 0)
+    {
+        RunEventMode(argPT, loops, numOfThreads, rate, duration, udp_batch, arrivals);
+        CorpusFree(&corpus);
+        free(arrivals);
+        return 0;
+    }
+
     //Creates list of threads
-    pthread_t threadList[numOfThreads];
+    if ((clnt = calloc(numOfThreads, sizeof(struct ClntThread))) == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, CLNT_STACK);
 
-    //Create # of clients
+    //Create # of clients; each waits for its own connect time
+    start = NowNs();
     for (i = 0; i < numOfThreads; i++)
     {
-        sleep(0.1);
-        pthread_create(&threadList[i], NULL, ClntConnection, (void *)argPT);
+        clnt[i].args = argPT;
+        clnt[i].connect_at = start + arrivals[i];
+        if (pthread_create(&clnt[i].thread, &attr, ClntConnection, &clnt[i]) != 0)
+        {
+            perror("pthread_create");
+            exit(1);
+        }
     }
 
     //Let main function finish when all threads finish
     for (i = 0; i < numOfThreads; i++)
     {
-        pthread_join(threadList[i], NULL);
+        pthread_join(clnt[i].thread, NULL);
+        connected += clnt[i].connected;
+        errors += clnt[i].errors;
+        requests += clnt[i].requests;
+        bytes += clnt[i].bytes;
+        if (clnt[i].connected)
+            HistRecord(&handshake, clnt[i].connect_ns);
     }
-    printf("Done\n");
+    secs = (NowNs() - start) / 1e9;
+    pthread_attr_destroy(&attr);
+
+    printf("Clients: %d threads, %lu connected, %lu errors\n", numOfThreads, connected, errors);
+    printf("Requests: %lu in %.2f s, %.0f requests/s, %.2f MB/s echoed\n",
+           requests, secs, requests / secs, bytes / secs / 1e6);
+    printf("latency_us, count, mean, p50, p90, p99, p99.9, max\n");
+    PrintLatency("connect", &handshake);
+    PrintLatency("rtt", &rtt);
+    free(clnt);
+    free(arrivals);
+    CorpusFree(&corpus);
     return (0);
 }
 
 void *ClntConnection(void *data)
 {
-    struct ConArgs *connectionArgs = data;
-    int port = connectionArgs->port;
-    char *host = connectionArgs->host;
-    int n, bytes_to_read, sd;
-    struct hostent *hp;
-    struct sockaddr_in server;
-    char *bp, rbuf[BUFLEN], sbuf[BUFLEN], **pptr, *sptr;
-    char str[16];
+    struct ClntThread *ct = data;
+    struct ConArgs *connectionArgs = ct->args;
+    struct Hist *hist;
+    uint64_t t0;
+    int sd;
 
-    //Mutex lock important Memory functions to prevent segmentation faults
-    pthread_mutex_lock(&lock);
+    if ((hist = malloc(sizeof(struct Hist))) == NULL)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    HistInit(hist);
 
-    // Open the text file and read it for data for sending
+    // Every client connects at its own time, in parallel with the others
+    SleepUntil(ct->connect_at);
+    t0 = NowNs();
+    if ((sd = socket(connectionArgs->server->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1
+        || connect(sd, connectionArgs->server, connectionArgs->server_len) == -1)
+    {
+        if (connectionArgs->verbose)
+            perror(connectionArgs->host);
+        ct->errors++;
+    }
+    else
+    {
+        ct->connect_ns = NowNs() - t0;
+        ct->connected = 1;
+        if (ClntSession(ct, sd, hist) == -1)
+            ct->errors++;
+    }
+    if (sd != -1)
+        close(sd);
 
-    //Ensure ulimit is a high value when testing: ulimit -n ####
-    FILE *fp = fopen("alice.txt", "r");
+    pthread_mutex_lock(&lock);
+    HistMerge(&rtt, hist);
+    pthread_mutex_unlock(&lock);
+    free(hist);
+    return NULL;
+}
 
-    // Create the socket
-    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+// Sends the corpus over sd, up to depth requests in flight, and waits for
+// every echo. Returns 0, or -1 if the connection failed.
+static int ClntSession(struct ClntThread *ct, int sd, struct Hist *hist)
+{
+    struct ConArgs *connectionArgs = ct->args;
+    const struct Corpus *corpus = connectionArgs->corpus;
+    int type, rc = 0;
+    char *rbuf;
+    size_t rcap, next = 0;
+    uint32_t rlen = 0;
+    int depth = connectionArgs->depth;
+    int head = 0, inflight = 0;
+    uint64_t *sent_at;      // send times of the requests in flight, oldest at head
+
+    // Room for the largest echo and a terminating null
+    rcap = corpus->max_len + 1;
+    if ((rbuf = malloc(rcap)) == NULL || (sent_at = malloc(depth * sizeof(uint64_t))) == NULL)
     {
-        perror("Cannot create socket");
+        perror("malloc");
         exit(1);
     }
 
-    bzero((char *)&server, sizeof(struct sockaddr_in));
+    while (1)
+    {
+        // Keep up to depth requests in flight, each the next corpus message
+        while (next < corpus->count && inflight < depth)
+        {
+            if (connectionArgs->verbose)
+            {
+                if (connectionArgs->text)
+                    printf("Transmit:\n%.*s", (int)corpus->msgs[next].len, CorpusFrame(corpus, next) + FRAME_HDRLEN);
+                else
+                    printf("Transmit:\n%u bytes\n", corpus->msgs[next].len);
+            }
+            sent_at[(head + inflight) % depth] = NowNs();
+            if (FrameWriten(sd, CorpusFrame(corpus, next), CorpusFrameLen(corpus, next)) == -1)
+            {
+                if (connectionArgs->verbose)
+                    perror("send");
+                rc = -1;
+                break;
+            }
+            next++;
+            inflight++;
+        }
+        if (inflight == 0 || rc == -1)
+            break;
+
+        // client waits for the whole echo of the oldest request
+        if (FrameRecv(sd, &type, &rbuf, &rcap, &rlen) != 1)
+        {
+            if (connectionArgs->verbose)
+                fprintf(stderr, "Connection closed by server\n");
+            rc = -1;
+            break;
+        }
+        HistRecord(hist, NowNs() - sent_at[head]);
+        head = (head + 1) % depth;
+        inflight--;
+        ct->requests++;
+        ct->bytes += FRAME_HDRLEN + rlen;
+        if (!connectionArgs->verbose)
+            continue;
+        if (connectionArgs->text)
+        {
+            if (rlen == rcap && (rbuf = realloc(rbuf, ++rcap)) == NULL)
+            {
+                perror("realloc");
+                exit(1);
+            }
+            rbuf[rlen] = '\0';
+            printf("Receive:\n%s\n", rbuf);
+        }
+        else
+            printf("Receive:\n%u bytes\n", rlen);
+        fflush(stdout);
+    }
+
+    //Send the close frame to end the session
+    if (rc == 0)
+    {
+        FrameSend(sd, FRAME_CLOSE, NULL, 0);
+        AwaitClose(sd);
+    }
+    free(sent_at);
+    free(rbuf);
+    return rc;
+}
+
+// Reads and discards what has arrived on fd without waiting. Returns 1 once
+// the server has closed the connection (or it failed), 0 if more may come.
+static int DrainInput(int fd, char *buf, size_t len)
+{
+    ssize_t n;
+
+    while ((n = recv(fd, buf, len, MSG_DONTWAIT)) > 0)
+        ;
+    return n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+// Ends the client's side of sd after its close frame and waits up to
+// CLOSE_WAIT_NS for the server to end its own. Closing with data unread
+// would reset the connection, which the server counts as a hangup.
+static void AwaitClose(int sd)
+{
+    struct pollfd pfd;
+    char buf[4096];
+    uint64_t end = NowNs() + CLOSE_WAIT_NS, now;
+
+    shutdown(sd, SHUT_WR);
+    pfd.fd = sd;
+    pfd.events = POLLIN;
+    while (!DrainInput(sd, buf, sizeof(buf)) && (now = NowNs()) < end)
+        if (poll(&pfd, 1, (int)((end - now + 999999) / 1000000)) == 0)
+            break;
+}
+
+// Monotonic time in nanoseconds
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Sleeps until monotonic time ns
+static void SleepUntil(uint64_t ns)
+{
+    struct timespec ts;
 
-    server.sin_family = AF_INET;
-    server.sin_port = htons(port);
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+// Fills server with the address of host and port, or of the socket path
+// host, and returns its length. Exits if there is no such host.
+static socklen_t ResolveServer(const char *host, int port, union ServerAddr *server)
+{
+    struct hostent *hp;
+    socklen_t len;
 
+    if (EndpointIsPath(host))
+    {
+        if ((len = EndpointUnixAddr(&server->un, host)) == 0)
+        {
+            perror(host);
+            exit(1);
+        }
+        return len;
+    }
     if ((hp = gethostbyname(host)) == NULL)
     {
         fprintf(stderr, "Unknown server address\n");
         exit(1);
     }
+    bzero((char *)&server->in, sizeof(struct sockaddr_in));
+    server->in.sin_family = AF_INET;
+    server->in.sin_port = htons(port);
+    bcopy(hp->h_addr, (char *)&server->in.sin_addr, hp->h_length);
+    return sizeof(struct sockaddr_in);
+}
+
+// Fills at with the connect times of n clients, in ns after the start of
+// the run and in order, following spec: "burst", "linear:seconds" or
+// "poisson:connects per second". Returns -1 if spec is none of these.
+static int ArrivalSchedule(const char *spec, int n, uint64_t *at)
+{
+    unsigned int seed = (unsigned int)NowNs();
+    double secs, rate, t = 0;
+    int i;
+
+    if (strcmp(spec, "burst") == 0)
+    {
+        for (i = 0; i < n; i++)
+            at[i] = 0;
+    }
+    else if (sscanf(spec, "linear:%lf", &secs) == 1 && secs >= 0)
+    {
+        for (i = 0; i < n; i++)
+            at[i] = (uint64_t)(secs * 1e9 * i / n);
+    }
+    else if (sscanf(spec, "poisson:%lf", &rate) == 1 && rate > 0)
+    {
+        // Exponential gaps between arrivals
+        for (i = 0; i < n; i++)
+        {
+            at[i] = (uint64_t)(t * 1e9);
+            t += -log(1.0 - rand_r(&seed) / (RAND_MAX + 1.0)) / rate;
+        }
+    }
+    else
+        return -1;
+    return 0;
+}
+
+// One CSV row of a latency histogram, in microseconds
+static void PrintLatency(const char *name, const struct Hist *h)
+{
+    printf("%s, %lu, %.1f, %.1f, %.1f, %.1f, %.1f, %.1f\n", name, h->count,
+           h->count ? h->sum / 1e3 / h->count : 0.0,
+           HistPercentile(h, 50) / 1e3, HistPercentile(h, 90) / 1e3,
+           HistPercentile(h, 99) / 1e3, HistPercentile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+static int RunEventMode(struct ConArgs *args, int loops, int clients, double rate, int duration, int udp_batch,
+                        const uint64_t *arrivals)
+{
+    struct LoadThread *threads;
+    struct rlimit rl;
+    uint64_t start, connected = 0, requests = 0, bytes = 0, errors = 0;
+    uint64_t lost = 0, sent = 0, sends = 0, received = 0, receives = 0;
+    double secs;
+    int i;
+
+    if (loops > clients)
+        loops = clients;
+
+    // One descriptor per connection plus a few per thread
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if ((threads = calloc(loops, sizeof(struct LoadThread))) == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    start = NowNs();
+    for (i = 0; i < loops; i++)
+    {
+        HistInit(&threads[i].connect);
+        HistInit(&threads[i].rtt);
+        HistInit(&threads[i].intended);
+        threads[i].server = args->server;
+        threads[i].server_len = args->server_len;
+        threads[i].conns = clients / loops + (i < clients % loops);
+        threads[i].interval = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+        // Clients i, i + loops, ... so every thread ramps up at once
+        threads[i].arrivals = arrivals + i;
+        threads[i].stride = loops;
+        threads[i].start = start;
+        threads[i].end = start + (uint64_t)duration * 1000000000ULL;
+        threads[i].corpus = args->corpus;
+        threads[i].depth = args->depth;
+        threads[i].udp_batch = udp_batch;
+        threads[i].seed = (unsigned int)start + i;
+        if (pthread_create(&threads[i].thread, NULL, udp_batch ? UdpLoop : LoadLoop, &threads[i]) != 0)
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (i = 0; i < loops; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        connected += threads[i].connected;
+        requests += threads[i].requests;
+        bytes += threads[i].bytes;
+        errors += threads[i].errors;
+        lost += threads[i].lost;
+        sent += threads[i].sent;
+        sends += threads[i].sends;
+        received += threads[i].received;
+        receives += threads[i].receives;
+        HistMerge(&handshake, &threads[i].connect);
+        HistMerge(&rtt, &threads[i].rtt);
+        HistMerge(&intended, &threads[i].intended);
+    }
+    secs = (NowNs() - start) / 1e9;
+
+    printf("Clients: %d over %d threads, %lu connected, %lu errors\n", clients, loops, connected, errors);
+    printf("Requests: %lu in %.2f s, %.0f requests/s, %.2f MB/s echoed\n",
+           requests, secs, requests / secs, bytes / secs / 1e6);
+    if (udp_batch)
+        printf("Datagrams: %lu sent, %lu lost, %.1f per sendmmsg, %.1f per recvmmsg\n", sent, lost,
+               sends ? (double)sent / sends : 0.0, receives ? (double)received / receives : 0.0);
+    printf("latency_us, count, mean, p50, p90, p99, p99.9, max\n");
+    if (!udp_batch)
+        PrintLatency("connect", &handshake);
+    PrintLatency("rtt", &rtt);
+    if (rate > 0)
+        PrintLatency("intended", &intended);
+    free(threads);
+    return 0;
+}
+
+// Send schedule: a binary min-heap of idle connections on next_send
+static void HeapSwap(struct LoadThread *t, int a, int b)
+{
+    struct LoadConn *c = t->heap[a];
+
+    t->heap[a] = t->heap[b];
+    t->heap[b] = c;
+    t->heap[a]->heap = a;
+    t->heap[b]->heap = b;
+}
+
+static void HeapUp(struct LoadThread *t, int i)
+{
+    while (i > 0 && t->heap[(i - 1) / 2]->next_send > t->heap[i]->next_send)
+    {
+        HeapSwap(t, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void HeapDown(struct LoadThread *t, int i)
+{
+    int m, l;
+
+    while ((l = 2 * i + 1) < t->nheap)
+    {
+        m = l;
+        if (l + 1 < t->nheap && t->heap[l + 1]->next_send < t->heap[l]->next_send)
+            m = l + 1;
+        if (t->heap[i]->next_send <= t->heap[m]->next_send)
+            break;
+        HeapSwap(t, i, m);
+        i = m;
+    }
+}
+
+static void HeapPush(struct LoadThread *t, struct LoadConn *c)
+{
+    c->heap = t->nheap;
+    t->heap[t->nheap++] = c;
+    HeapUp(t, c->heap);
+}
+
+static void HeapRemove(struct LoadThread *t, struct LoadConn *c)
+{
+    int i = c->heap;
 
-    bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
+    if (i < 0)
+        return;
+    c->heap = -1;
+    if (i == --t->nheap)
+        return;
+    t->heap[i] = t->heap[t->nheap];
+    t->heap[i]->heap = i;
+    HeapUp(t, i);
+    HeapDown(t, t->heap[i]->heap);
+}
 
-    // Connecting to the server
-    if (connect(sd, (struct sockaddr *)&server, sizeof(server)) == -1)
+// Drops a connection after an error; the rest of the run carries on
+static void LoadFail(struct LoadThread *t, struct LoadConn *c)
+{
+    HeapRemove(t, c);
+    close(c->fd);
+    c->fd = -1;
+    t->errors++;
+}
+
+// Opens connection c; completion is reported as writability. Until then
+// next_send holds when the connect started.
+static void LoadConnect(struct LoadThread *t, struct LoadConn *c, int epoll_fd, uint64_t now)
+{
+    struct epoll_event event;
+
+    if ((c->fd = socket(t->server->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+    {
+        perror("Cannot create socket");
+        t->errors++;
+        return;
+    }
+    if (connect(c->fd, t->server, t->server_len) == -1 && errno != EINPROGRESS)
     {
-        fprintf(stderr, "Can't connect to server\n");
-        perror("connect");
+        LoadFail(t, c);
+        return;
+    }
+    c->next_send = now;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &event) == -1)
+    {
+        perror("epoll_ctl");
         exit(1);
     }
-    // printf("Connected: Server Name: %s\n", hp->h_name);
-    pptr = hp->h_addr_list;
-    // printf("\t\tIP Address: %s\n", inet_ntop(hp->h_addrtype, *pptr, str, sizeof(str)));
+}
+
+// Queues one more request on c, scheduled for c->next_send, and moves the
+// schedule on: by one interval, or to now when sending back to back.
+static void LoadQueue(struct LoadThread *t, struct LoadConn *c, uint64_t now)
+{
+    int slot = (c->head + c->inflight) % t->depth;
 
-    //Enters Loop to periodically Send text
-    //gets(sbuf); // get user's text
+    c->sent_at[slot] = now;
+    c->intended[slot] = c->next_send;
+    c->inflight++;
+    c->wleft += CorpusFrameLen(t->corpus, c->next);
+    c->next = (c->next + 1) % t->corpus->count;
+    c->next_send = t->interval ? c->next_send + t->interval : now;
+}
 
-    //Finished Memory stuff, let threads send stuff now
-    pthread_mutex_unlock(&lock);
+// Writes as much of the queued requests as the socket takes. Returns -1 on
+// error.
+static int LoadWrite(struct LoadThread *t, struct LoadConn *c)
+{
+    size_t chunk;
+    ssize_t n;
+
+    while (c->wleft > 0)
+    {
+        // The queued frames are contiguous up to the end of the corpus
+        chunk = t->corpus->frames_len - c->wpos;
+        if (chunk > c->wleft)
+            chunk = c->wleft;
+        n = send(c->fd, t->corpus->frames + c->wpos, chunk, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        c->wleft -= n;
+        if ((c->wpos += n) == t->corpus->frames_len)
+            c->wpos = 0;
+    }
+    return 0;
+}
+
+// Reads echo bytes and retires the requests whose echo is complete; the
+// echo is byte-for-byte the request, so only the count matters. Returns -1
+// on error or EOF.
+static int LoadRead(struct LoadThread *t, struct LoadConn *c, char *scratch, size_t cap, uint64_t now)
+{
+    size_t take, flen;
+    ssize_t n;
+
+    while (1)
+    {
+        n = recv(c->fd, scratch, cap, 0);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        if (n == 0)
+            return -1;
+        while (n > 0)
+        {
+            if (c->inflight == 0)
+                return -1;  // more echoed than was sent
+            flen = CorpusFrameLen(t->corpus, c->oldest);
+            take = flen - c->rgot;
+            if (take > (size_t)n)
+                take = n;
+            c->rgot += take;
+            n -= take;
+            if (c->rgot < flen)
+                break;
+
+            c->rgot = 0;
+            c->oldest = (c->oldest + 1) % t->corpus->count;
+            t->requests++;
+            t->bytes += flen;
+            HistRecord(&t->rtt, now - c->sent_at[c->head]);
+            if (t->interval)
+                HistRecord(&t->intended, now - c->intended[c->head]);
+            c->head = (c->head + 1) % t->depth;
+            c->inflight--;
+        }
+    }
+}
 
-    while (fgets(sbuf, BUFLEN, fp) != 0)
+static void *LoadLoop(void *data)
+{
+    struct LoadThread *t = data;
+    struct epoll_event events[EV_MAX_EVENTS];
+    struct LoadConn *c;
+    unsigned char close_hdr[FRAME_HDRLEN];
+    char scratch[65536];
+    uint64_t now, wait, arrive, deadline, *stamps;
+    int epoll_fd, i, n, err, closing;
+    socklen_t len;
+
+    t->conn = calloc(t->conns, sizeof(struct LoadConn));
+    t->heap = calloc(t->conns, sizeof(struct LoadConn *));
+    stamps = calloc((size_t)t->conns * t->depth * 2, sizeof(uint64_t));
+    if (t->conn == NULL || t->heap == NULL || stamps == NULL || (epoll_fd = epoll_create1(0)) == -1)
     {
+        perror("event loop setup");
+        exit(1);
+    }
 
-        // printf("Now sleeping\n");
-        // sleep(1);
+    for (i = 0; i < t->conns; i++)
+    {
+        c = &t->conn[i];
+        c->fd = -1;
+        c->heap = -1;
+        c->state = LC_CONNECTING;
+        c->sent_at = stamps + (size_t)i * t->depth * 2;
+        c->intended = c->sent_at + t->depth;
+    }
 
-        //Get from file
-        printf("Transmit:\n");
-        printf("%s", sbuf);
-        write(sd, sbuf, BUFLEN);
+    while ((now = NowNs()) < t->end)
+    {
+        // Open the connections whose arrival time has come
+        while (t->started < t->conns && t->start + t->arrivals[(size_t)t->started * t->stride] <= now)
+            LoadConnect(t, &t->conn[t->started++], epoll_fd, now);
 
-        //Set up receive
-        printf("Receive:\n");
-        bp = rbuf;
-        bytes_to_read = BUFLEN;
+        // Sleep until the next request or arrival is due, events arrive or
+        // time is up
+        wait = t->end - now;
+        if (t->nheap > 0 && t->heap[0]->next_send < t->end)
+            wait = t->heap[0]->next_send > now ? t->heap[0]->next_send - now : 0;
+        if (t->started < t->conns)
+        {
+            arrive = t->start + t->arrivals[(size_t)t->started * t->stride];
+            if (arrive - now < wait)
+                wait = arrive - now;
+        }
+        if ((n = epoll_wait(epoll_fd, events, EV_MAX_EVENTS, (int)((wait + 999999) / 1000000))) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            exit(1);
+        }
+        now = NowNs();
 
-        // client makes repeated calls to recv until no more data is expected to arrive.
-        n = 0;
-        while ((n = recv(sd, bp, bytes_to_read, 0)) < BUFLEN)
+        for (i = 0; i < n; i++)
         {
-            bp += n;
-            bytes_to_read -= n;
+            c = events[i].data.ptr;
+            if (c->fd == -1)
+                continue;
+            if (c->state == LC_CONNECTING)
+            {
+                if (!(events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+                    continue;
+                len = sizeof(err);
+                if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0)
+                {
+                    LoadFail(t, c);
+                    continue;
+                }
+                t->connected++;
+                HistRecord(&t->connect, now - c->next_send);
+                // Spread the first requests over one interval so the
+                // connections don't all fire in step
+                c->next_send = t->interval ? now + rand_r(&t->seed) % t->interval : now;
+                // and start each at its own place in the corpus
+                c->next = c->oldest = rand_r(&t->seed) % t->corpus->count;
+                c->wpos = t->corpus->msgs[c->next].off;
+                c->state = LC_OPEN;
+                HeapPush(t, c);
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+            {
+                LoadFail(t, c);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && LoadWrite(t, c) == -1)
+            {
+                LoadFail(t, c);
+                continue;
+            }
+            if (events[i].events & EPOLLIN)
+            {
+                if (LoadRead(t, c, scratch, sizeof(scratch), now) == -1)
+                {
+                    LoadFail(t, c);
+                    continue;
+                }
+                // A slot opened up: back into the schedule
+                if (c->heap == -1 && c->inflight < t->depth)
+                {
+                    if (t->interval == 0)
+                        c->next_send = now;
+                    HeapPush(t, c);
+                }
+            }
         }
-        printf("%s\n", rbuf);
-        fflush(stdout);
+
+        // Send every request that is due, up to depth in flight, with one
+        // send per connection
+        now = NowNs();
+        while (t->nheap > 0 && t->heap[0]->next_send <= now)
+        {
+            c = t->heap[0];
+            HeapRemove(t, c);
+            while (c->inflight < t->depth && c->next_send <= now)
+                LoadQueue(t, c, now);
+            if (LoadWrite(t, c) == -1)
+                LoadFail(t, c);
+            else if (c->inflight < t->depth)
+                HeapPush(t, c);
+        }
+    }
+
+    // Say goodbye where a frame boundary allows it and end our side. The
+    // echoes still on their way are read and dropped until the server
+    // closes too: closing with data unread would reset the connection,
+    // which the server counts as a hangup.
+    FrameHeader(close_hdr, FRAME_CLOSE, 0);
+    closing = 0;
+    for (i = 0; i < t->conns; i++)
+    {
+        c = &t->conn[i];
+        if (c->fd == -1)
+            continue;
+        if (c->state == LC_OPEN)
+        {
+            if (c->wleft == 0)
+                send(c->fd, close_hdr, FRAME_HDRLEN, MSG_NOSIGNAL | MSG_DONTWAIT);
+            shutdown(c->fd, SHUT_WR);
+            // Edge-triggered: what is buffered already won't be reported
+            if (!DrainInput(c->fd, scratch, sizeof(scratch)))
+            {
+                closing++;
+                continue;
+            }
+        }
+        close(c->fd);
+        c->fd = -1;
+    }
+    now = NowNs();
+    deadline = now + CLOSE_WAIT_NS;
+    while (closing > 0 && now < deadline)
+    {
+        if ((n = epoll_wait(epoll_fd, events, EV_MAX_EVENTS, (int)((deadline - now + 999999) / 1000000))) == -1
+            && errno != EINTR)
+            break;
+        for (i = 0; i < n; i++)
+        {
+            c = events[i].data.ptr;
+            if (c->fd != -1 && DrainInput(c->fd, scratch, sizeof(scratch)))
+            {
+                close(c->fd);
+                c->fd = -1;
+                closing--;
+            }
+        }
+        now = NowNs();
+    }
+    for (i = 0; i < t->conns; i++)
+        if (t->conn[i].fd != -1)
+            close(t->conn[i].fd);
+    close(epoll_fd);
+    free(t->conn);
+    free(t->heap);
+    free(stamps);
+    return NULL;
+}
+
+// Frees the slot of c's oldest request, whose echo is counted as lost
+static void UdpLose(struct LoadThread *t, struct LoadConn *c)
+{
+    c->head = (c->head + 1) % t->depth;
+    c->inflight--;
+    t->lost++;
+}
+
+// Takes an echo off the socket buffer slot and retires its request. Echoes
+// come back in order unless some were lost, so the requests before it on
+// the same client are given up; an echo older than every request in
+// flight arrived after its request was given up and is ignored.
+static void UdpEcho(struct LoadThread *t, const char *buf, size_t len, uint64_t now)
+{
+    struct LoadConn *c;
+    uint32_t tag[2], behind;
+
+    if (len < UDP_TAGLEN)
+        return;
+    memcpy(tag, buf, UDP_TAGLEN);
+    if (tag[0] >= (uint32_t)t->conns)
+        return;
+    c = &t->conn[tag[0]];
+    behind = tag[1] - (c->seq - c->inflight);
+    if (behind >= (uint32_t)c->inflight)
+        return;
+    while (behind-- > 0)
+        UdpLose(t, c);
+
+    t->requests++;
+    t->bytes += len - UDP_TAGLEN;
+    HistRecord(&t->rtt, now - c->sent_at[c->head]);
+    if (t->interval)
+        HistRecord(&t->intended, now - c->intended[c->head]);
+    c->head = (c->head + 1) % t->depth;
+    c->inflight--;
+
+    // A slot opened up: back into the schedule
+    if (c->heap == -1)
+    {
+        if (t->interval == 0)
+            c->next_send = now;
+        HeapPush(t, c);
+    }
+}
+
+// UDP mode loop thread: the same schedule as LoadLoop, over one datagram
+// socket shared by all of the thread's clients
+static void *UdpLoop(void *data)
+{
+    struct LoadThread *t = data;
+    struct epoll_event event, events[1];
+    struct LoadConn *c;
+    struct mmsghdr *smsg, *rmsg;
+    struct iovec *siov, *riov;
+    uint32_t *stag;
+    char *rbuf;
+    size_t rlen = UDP_TAGLEN + FRAME_HDRLEN + t->corpus->max_len;
+    uint64_t now, wait, sweep, *stamps;
+    int fd, epoll_fd, i, n, batch = t->udp_batch, arg = UDP_SOCKBUF;
+
+    t->conn = calloc(t->conns, sizeof(struct LoadConn));
+    t->heap = calloc(t->conns, sizeof(struct LoadConn *));
+    stamps = calloc((size_t)t->conns * t->depth * 2, sizeof(uint64_t));
+    smsg = calloc(batch, sizeof(struct mmsghdr));
+    rmsg = calloc(batch, sizeof(struct mmsghdr));
+    siov = calloc(batch * 2, sizeof(struct iovec));
+    riov = calloc(batch, sizeof(struct iovec));
+    stag = calloc(batch * 2, sizeof(uint32_t));
+    rbuf = malloc(batch * rlen);
+    if (t->conn == NULL || t->heap == NULL || stamps == NULL || smsg == NULL || rmsg == NULL
+        || siov == NULL || riov == NULL || stag == NULL || rbuf == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    // Datagram i of a send batch is its tag and a corpus frame; echo i of
+    // a receive batch lands in its own slot of rbuf
+    for (i = 0; i < batch; i++)
+    {
+        siov[2 * i].iov_base = &stag[2 * i];
+        siov[2 * i].iov_len = UDP_TAGLEN;
+        smsg[i].msg_hdr.msg_iov = &siov[2 * i];
+        smsg[i].msg_hdr.msg_iovlen = 2;
+        riov[i].iov_base = rbuf + (size_t)i * rlen;
+        riov[i].iov_len = rlen;
+        rmsg[i].msg_hdr.msg_iov = &riov[i];
+        rmsg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1
+        || connect(fd, t->server, t->server_len) == -1
+        || (epoll_fd = epoll_create1(0)) == -1)
+    {
+        perror("UDP socket setup");
+        exit(1);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &arg, sizeof(arg));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &arg, sizeof(arg));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        perror("epoll_ctl");
+        exit(1);
     }
 
-    sbuf[0] = '\0';
+    // Nothing to wait for: every client starts at once
+    now = NowNs();
+    for (i = 0; i < t->conns; i++)
+    {
+        c = &t->conn[i];
+        c->fd = -1;
+        c->sent_at = stamps + (size_t)i * t->depth * 2;
+        c->intended = c->sent_at + t->depth;
+        c->next_send = t->interval ? now + rand_r(&t->seed) % t->interval : now;
+        c->next = c->oldest = rand_r(&t->seed) % t->corpus->count;
+        c->state = LC_OPEN;
+        HeapPush(t, c);
+    }
+    t->connected = t->conns;
+    sweep = now + UDP_SWEEP_NS;
 
-    // printf("Finished with reading file, sending EOF\n");
-    //Send last string with ending line
-    write(sd, sbuf, BUFLEN);
+    while ((now = NowNs()) < t->end)
+    {
+        wait = t->end - now;
+        if (sweep < now + wait)
+            wait = sweep > now ? sweep - now : 0;
+        if (t->nheap > 0 && t->heap[0]->next_send < now + wait)
+            wait = t->heap[0]->next_send > now ? t->heap[0]->next_send - now : 0;
+        if ((n = epoll_wait(epoll_fd, events, 1, (int)((wait + 999999) / 1000000))) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            exit(1);
+        }
+
+        // Echoes, batch at a time; a short batch means the socket is empty
+        while (n > 0)
+        {
+            n = recvmmsg(fd, rmsg, batch, MSG_DONTWAIT, NULL);
+            if (n == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    t->errors++;    // e.g. ECONNREFUSED with no server
+                break;
+            }
+            now = NowNs();
+            t->receives++;
+            t->received += n;
+            for (i = 0; i < n; i++)
+                UdpEcho(t, riov[i].iov_base, rmsg[i].msg_len, now);
+            if (n < batch)
+                break;
+        }
+
+        // Give up on echoes that are too late
+        now = NowNs();
+        if (now >= sweep)
+        {
+            for (i = 0; i < t->conns; i++)
+            {
+                c = &t->conn[i];
+                while (c->inflight > 0 && now - c->sent_at[c->head] >= UDP_LOSS_NS)
+                    UdpLose(t, c);
+                if (c->heap == -1 && c->inflight < t->depth)
+                {
+                    if (t->interval == 0)
+                        c->next_send = now;
+                    HeapPush(t, c);
+                }
+            }
+            sweep = now + UDP_SWEEP_NS;
+        }
+
+        // Every request that is due, on any client, batch at a time
+        while (t->nheap > 0 && t->heap[0]->next_send <= now)
+        {
+            for (n = 0; n < batch && t->nheap > 0 && t->heap[0]->next_send <= now; )
+            {
+                c = t->heap[0];
+                HeapRemove(t, c);
+                for (; n < batch && c->inflight < t->depth && c->next_send <= now; n++)
+                {
+                    stag[2 * n] = c - t->conn;
+                    stag[2 * n + 1] = c->seq++;
+                    siov[2 * n + 1].iov_base = (void *)CorpusFrame(t->corpus, c->next);
+                    siov[2 * n + 1].iov_len = CorpusFrameLen(t->corpus, c->next);
+                    LoadQueue(t, c, now);
+                }
+                if (c->inflight < t->depth)
+                    HeapPush(t, c);
+            }
+            // Datagrams the socket refuses time out as lost
+            i = sendmmsg(fd, smsg, n, 0);
+            t->sends++;
+            if (i == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    t->errors++;
+                break;
+            }
+            t->sent += i;
+            if (i < n)
+                break;
+        }
+    }
 
-    //Properly close file when finished
-    fclose(fp);
-    close(sd);
-    // printf("%d done\n", pthread_self());
+    close(fd);
+    close(epoll_fd);
+    free(t->conn);
+    free(t->heap);
+    free(stamps);
+    free(smsg);
+    free(rmsg);
+    free(siov);
+    free(riov);
+    free(stag);
+    free(rbuf);
     return NULL;
 }
@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		tsc.c -   Cheap interval timing from the CPU time-stamp counter
+--
+--	FUNCTIONS:		TscInit
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See tsc.h. Calibration spins for TSC_CALIBRATE_MS against the monotonic
+--	clock; the error is a few parts per million.
+---------------------------------------------------------------------------------------*/
+#include "tsc.h"
+#if defined (__x86_64__) || defined (__i386__)
+#include <cpuid.h>
+#endif
+
+#define TSC_CALIBRATE_MS	20
+
+int tsc_invariant = 0;
+double tsc_ns_per_tick = 1.0;
+
+static uint64_t MonotonicNs (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Decides between the counter and the clock, and calibrates the counter.
+// Call once before any thread uses TscNow.
+void TscInit (void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+	unsigned int eax, ebx, ecx, edx;
+	uint64_t t0, t1, c0, c1;
+
+	// CPUID 0x80000007 EDX bit 8: invariant TSC
+	if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8)))
+		return;
+
+	t0 = MonotonicNs ();
+	c0 = __rdtsc ();
+	do
+		t1 = MonotonicNs ();
+	while (t1 - t0 < TSC_CALIBRATE_MS * 1000000ULL);
+	c1 = __rdtsc ();
+	if (c1 <= c0)
+		return;
+
+	tsc_ns_per_tick = (double) (t1 - t0) / (c1 - c0);
+	tsc_invariant = 1;
+#endif
+}
@@ -0,0 +1,54 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		tsc.h -   Cheap interval timing from the CPU time-stamp counter
+--
+--	FUNCTIONS:		TscInit
+--				TscNow
+--				TscToNs
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	TscNow reads the time-stamp counter, a few cycles and no system call,
+--	for timing short spans such as one connection's share of an event-loop
+--	pass. TscInit calibrates counter ticks against CLOCK_MONOTONIC once at
+--	start-up. Where the counter isn't invariant (it would stop in deep idle
+--	or change rate with the clock), or on other architectures, TscNow falls
+--	back to CLOCK_MONOTONIC and the ticks are nanoseconds.
+--
+--	Use it for durations only: counters of different cores are synchronized
+--	on current hardware but the reading is not a time of day.
+---------------------------------------------------------------------------------------*/
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
+
+extern int tsc_invariant;		// TscNow reads the counter
+extern double tsc_ns_per_tick;
+
+void TscInit (void);
+
+static inline uint64_t TscNow (void)
+{
+	struct timespec ts;
+
+#if defined (__x86_64__) || defined (__i386__)
+	if (tsc_invariant)
+		return __rdtsc ();
+#endif
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline double TscToNs (uint64_t ticks)
+{
+	return ticks * tsc_ns_per_tick;
+}
+
+#endif
@@ -0,0 +1,645 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		uring_svr.c -   An echo server using io_uring
+--
+--	PROGRAM:		urings
+--				gcc -Wall -ggdb -o urings uring_svr.c connlog.c tsc.c -lpthread
+--
+--	FUNCTIONS:		Berkeley Socket API
+--				io_uring_setup, io_uring_enter, io_uring_register
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--				October 2026
+--				Time used is the client's lifetime on the monotonic clock
+--				instead of a difference of clock() values
+--				Listens on a Unix-domain socket when given a path
+--				instead of a port (endpoint.h)
+--				Per-client summaries go to a binary log (-l, see
+--				connlog.c) instead of stdout, written by a log
+--				thread; service time is timed with the TSC (tsc.c)
+--				A read that finds no provided buffer waits for one
+--				to be returned instead of retrying at once
+--
+--	NOTES:
+--	Third backend next to mux_svr.c (select) and epoll_svr.c (epoll). It speaks
+--	the same framed protocol (frame.h) and logs the same per-client record
+--	as mux_svr.c (connlog.h), so results compare directly.
+--
+--	The ring is driven through the raw system calls, no liburing needed:
+--	- one multishot accept SQE produces a CQE for every new connection
+--	- reads use a provided buffer ring, so idle connections pin no memory
+--	- frames that arrive complete are echoed with a single send; for a frame
+--	  that is still arriving, the rest of the payload is read with a recv
+--	  linked to the send of the whole frame, so the echo needs no trip
+--	  through user space between the two
+--	Each connection has at most one chain of SQEs in flight, which keeps the
+--	replies in order. On CTRL-c or SIGTERM the server prints how many io_uring_enter
+--	calls it made per echoed message.
+--	Requires Linux 6.0 or later (multishot accept, buffer rings).
+---------------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/io_uring.h>
+#include "frame.h"
+#include "endpoint.h"
+#include "connlog.h"
+#include "tsc.h"
+
+#define SERVER_TCP_PORT	7002	// Default port
+#define TRUE		1
+#define FALSE		0
+#define LISTENQ		SOMAXCONN
+#define RING_ENTRIES	4096	// submission queue size
+#define NUM_BUFS	1024	// provided buffers, must be a power of 2
+#define BUF_SIZE	16384	// size of each provided buffer
+#define BUF_GROUP	0
+#define STARVE_NS	1000000	// retry of reads that found no buffer, if none came back
+#define LOG_FILE	"uring_svr.log"	// Default connection log, "logcsv uring_svr.log" prints it
+
+// Operation encoded in the low bits of each SQE's user_data
+#define OP_ACCEPT	0
+#define OP_RECV		1	// buffer-select recv of whatever has arrived
+#define OP_SEND		2	// send of complete frames from the staging buffer
+#define OP_RECV_REST	3	// linked recv of the rest of a frame's payload
+#define OP_SEND_FRAME	4	// linked send of that frame
+#define OP_TIMEOUT	5	// STARVE_NS timeout for the reads waiting on buffers
+#define OP_MASK		7
+
+// Mapped submission and completion queues
+struct Ring
+{
+	int fd;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned sq_entries, sq_local_tail, to_submit;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+// Per-client state
+struct Connection
+{
+	int fd;
+	int number;
+	int port;
+	struct in_addr ip;
+	struct timespec start;	// accepted (monotonic)
+	uint64_t active;	// TSC ticks spent serving the client
+	int requests;
+	size_t bytes;
+
+	char *buf;		// partial frame, then complete frames being echoed
+	size_t cap;
+	size_t len;
+	size_t sent;		// bytes of buf covered by the chain in flight
+	size_t frame;		// size of the frame completed by OP_RECV_REST, 0 if none
+
+	int inflight;		// SQEs of the current chain not yet completed
+	int dead;		// I/O failed or the peer went away
+	int closing;		// close frame received
+	struct Connection *next_starved;	// on the starved list, waiting for a buffer
+};
+
+// Function Prototypes
+static void SystemFatal (const char *);
+static void RingInit (struct Ring *ring, unsigned entries);
+static struct io_uring_sqe *GetSqe (struct Ring *ring);
+static int Submit (struct Ring *ring, unsigned wait);
+static void SetupBuffers (struct Ring *ring);
+static void RecycleBuffer (struct Ring *ring, int bid);
+static void PrepAccept (struct Ring *ring, int listen_sd);
+static void PrepRecv (struct Ring *ring, struct Connection *c);
+static void Starve (struct Ring *ring, struct Connection *c);
+static void HandleCompletion (struct Ring *ring, struct io_uring_cqe *cqe, int listen_sd);
+static int ParseInput (struct Ring *ring, struct Connection *c);
+static int ChainDone (struct Ring *ring, struct Connection *c);
+static void catch_int (int);
+
+// Globals
+static volatile sig_atomic_t stop = FALSE;
+static struct io_uring_buf_ring *buf_ring;
+static char *buf_base;
+static unsigned short buf_tail;
+static struct Connection *starved;	// reads that found no buffer, oldest first
+static struct Connection **starved_end = &starved;
+static int starve_timer = FALSE;	// an OP_TIMEOUT is in flight
+static struct __kernel_timespec starve_ts = { 0, STARVE_NS };
+static uint64_t cqe_start;		// TscNow when the completion being handled was taken
+static struct ConnLog *conn_log;
+static int numOfClients = 0;
+static unsigned long enter_calls = 0;
+static unsigned long messages = 0;
+
+int main (int argc, char **argv)
+{
+	int arg, opt, port = SERVER_TCP_PORT, listen_sd;
+	const char *unix_path = NULL;	// Unix-domain endpoint in place of the port
+	const char *log_path = LOG_FILE;
+	unsigned head, tail;
+	struct Ring ring;
+	struct sockaddr_in server;
+	struct sigaction act;
+
+	while ((opt = getopt(argc, argv, "l:")) != -1)
+	{
+		if (opt != 'l')
+		{
+			fprintf(stderr, "Usage: %s [-l log file] [port | socket path]\n", argv[0]);
+			exit(1);
+		}
+		log_path = optarg;
+	}
+	if (optind < argc)
+	{
+		if (EndpointIsPath(argv[optind]))
+			unix_path = argv[optind];
+		else
+			port = atoi(argv[optind]);	// Get user specified port
+	}
+
+	// Service time is taken from the TSC; the summary of every client is
+	// written out by a log thread
+	TscInit();
+	if ((conn_log = ConnLogOpen(log_path, 1)) == NULL)
+		SystemFatal(log_path);
+
+	// CTRL-c, or a plain kill, interrupts io_uring_enter so the summary
+	// can be printed and the log drained
+	act.sa_handler = catch_int;
+	act.sa_flags = 0;
+	if (sigemptyset(&act.sa_mask) == -1 || sigaction(SIGINT, &act, NULL) == -1
+		|| sigaction(SIGTERM, &act, NULL) == -1)
+		SystemFatal("sigaction");
+	signal(SIGPIPE, SIG_IGN);
+
+	if (unix_path)
+	{
+		if ((listen_sd = EndpointListenUnix(unix_path, 0)) == -1)
+			SystemFatal(unix_path);
+	}
+	else
+	{
+		// Create a stream socket
+		if ((listen_sd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+			SystemFatal("Cannot Create Socket!");
+
+		// set SO_REUSEADDR so port can be resused imemediately after exit, i.e., after CTRL-c
+		arg = 1;
+		if (setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, &arg, sizeof(arg)) == -1)
+			SystemFatal("setsockopt");
+
+		// Bind an address to the socket
+		bzero((char *) &server, sizeof(struct sockaddr_in));
+		server.sin_family = AF_INET;
+		server.sin_port = htons(port);
+		server.sin_addr.s_addr = htonl(INADDR_ANY); // Accept connections from any client
+
+		if (bind(listen_sd, (struct sockaddr *) &server, sizeof(server)) == -1)
+			SystemFatal("bind error");
+
+		if (listen(listen_sd, LISTENQ) == -1)
+			SystemFatal("listen");
+	}
+
+	RingInit(&ring, RING_ENTRIES);
+	SetupBuffers(&ring);
+	PrepAccept(&ring, listen_sd);
+
+	while (!stop)
+	{
+		// One system call submits everything queued and waits for work
+		if (Submit(&ring, 1) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			SystemFatal("io_uring_enter");
+		}
+
+		head = *ring.cq_head;
+		tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail)
+		{
+			HandleCompletion(&ring, &ring.cqes[head & *ring.cq_mask], listen_sd);
+			head++;
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	fprintf(stderr, "io_uring_enter calls: %lu, messages echoed: %lu, syscalls per message: %.4f\n",
+		enter_calls, messages, messages ? (double) enter_calls / messages : 0.0);
+	close(listen_sd);
+	if (unix_path)
+		unlink(unix_path);
+	ConnLogClose(conn_log);
+	return (0);
+}
+
+// Sets up the ring and maps its queues.
+static void RingInit (struct Ring *ring, unsigned entries)
+{
+	struct io_uring_params p;
+	size_t sq_size, cq_size;
+	char *sq_ptr, *cq_ptr;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd == -1)
+		SystemFatal("io_uring_setup");
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		SystemFatal("mmap");
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else if ((cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+		SystemFatal("mmap");
+
+	ring->sq_head = (unsigned *) (sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq_ptr + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	ring->sq_local_tail = *ring->sq_tail;
+	ring->to_submit = 0;
+
+	ring->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		SystemFatal("mmap");
+
+	ring->cq_head = (unsigned *) (cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq_ptr + p.cq_off.cqes);
+}
+
+// Returns a cleared SQE, submitting the queue first if it is full.
+static struct io_uring_sqe *GetSqe (struct Ring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned idx;
+
+	while (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+	{
+		if (Submit(ring, 0) == -1 && errno != EINTR && errno != EBUSY)
+			SystemFatal("io_uring_enter");
+	}
+
+	idx = ring->sq_local_tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	ring->sq_local_tail++;
+	ring->to_submit++;
+	return sqe;
+}
+
+// Publishes the queued SQEs and enters the kernel, waiting for wait CQEs.
+static int Submit (struct Ring *ring, unsigned wait)
+{
+	int n;
+
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+	enter_calls++;
+	n = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (n >= 0)
+		ring->to_submit -= n;
+	return n;
+}
+
+// Registers the provided buffer ring and hands every buffer to the kernel.
+static void SetupBuffers (struct Ring *ring)
+{
+	struct io_uring_buf_reg reg;
+	int i;
+
+	buf_ring = mmap(NULL, NUM_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf_ring == MAP_FAILED)
+		SystemFatal("mmap");
+	if ((buf_base = malloc((size_t) NUM_BUFS * BUF_SIZE)) == NULL)
+		SystemFatal("malloc");
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) buf_ring;
+	reg.ring_entries = NUM_BUFS;
+	reg.bgid = BUF_GROUP;
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+		SystemFatal("io_uring_register");
+
+	buf_tail = 0;
+	for (i = 0; i < NUM_BUFS; i++)
+		RecycleBuffer(ring, i);
+}
+
+// Gives buffer bid back to the kernel, and with it another try to the
+// read that has waited longest for one.
+static void RecycleBuffer (struct Ring *ring, int bid)
+{
+	struct io_uring_buf *b = &buf_ring->bufs[buf_tail & (NUM_BUFS - 1)];
+	struct Connection *c;
+
+	b->addr = (unsigned long) (buf_base + (size_t) bid * BUF_SIZE);
+	b->len = BUF_SIZE;
+	b->bid = bid;
+	buf_tail++;
+	__atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+
+	if ((c = starved) == NULL)
+		return;
+	if ((starved = c->next_starved) == NULL)
+		starved_end = &starved;
+	PrepRecv(ring, c);
+}
+
+// Arms the multishot accept on the listening socket.
+static void PrepAccept (struct Ring *ring, int listen_sd)
+{
+	struct io_uring_sqe *sqe = GetSqe(ring);
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listen_sd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = OP_ACCEPT;
+}
+
+// Reads whatever has arrived into a buffer picked by the kernel.
+static void PrepRecv (struct Ring *ring, struct Connection *c)
+{
+	struct io_uring_sqe *sqe = GetSqe(ring);
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUF_GROUP;
+	sqe->user_data = (unsigned long) c | OP_RECV;
+	c->inflight = 1;
+}
+
+// Parks a read that found the buffer ring empty until a buffer is returned.
+// The buffers it wants may have come back before its completion was seen,
+// so a timeout retries every waiting read after STARVE_NS all the same.
+static void Starve (struct Ring *ring, struct Connection *c)
+{
+	struct io_uring_sqe *sqe;
+
+	c->next_starved = NULL;
+	*starved_end = c;
+	starved_end = &c->next_starved;
+	if (starve_timer)
+		return;
+	sqe = GetSqe(ring);
+	sqe->opcode = IORING_OP_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (unsigned long) &starve_ts;
+	sqe->len = 1;
+	sqe->user_data = OP_TIMEOUT;
+	starve_timer = TRUE;
+}
+
+static void PrepSendRecv (struct Ring *ring, struct Connection *c, int op, char *buf, size_t len, int link)
+{
+	struct io_uring_sqe *sqe = GetSqe(ring);
+
+	sqe->opcode = (op == OP_RECV_REST) ? IORING_OP_RECV : IORING_OP_SEND;
+	sqe->fd = c->fd;
+	sqe->addr = (unsigned long) buf;
+	sqe->len = len;
+	sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+	sqe->flags = link ? IOSQE_IO_LINK : 0;
+	sqe->user_data = (unsigned long) c | op;
+	c->inflight++;
+}
+
+static void HandleCompletion (struct Ring *ring, struct io_uring_cqe *cqe, int listen_sd)
+{
+	struct Connection *c = (struct Connection *) (unsigned long) (cqe->user_data & ~(unsigned long long) OP_MASK);
+	int op = cqe->user_data & OP_MASK;
+	struct sockaddr_in client_addr;
+	socklen_t client_len = sizeof(client_addr);
+	int bid, closed = FALSE;
+
+	cqe_start = TscNow();
+	switch (op)
+	{
+		case OP_ACCEPT:
+			if (!(cqe->flags & IORING_CQE_F_MORE))
+				PrepAccept(ring, listen_sd);	// multishot ended, re-arm
+			if (cqe->res < 0)
+			{
+				fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+				return;
+			}
+
+			//Accepted the a new client, increment to tell what client number they are.
+			numOfClients += 1;
+			if ((c = calloc(1, sizeof(struct Connection))) == NULL)
+				SystemFatal("calloc");
+			c->fd = cqe->res;
+			c->number = numOfClients;
+			clock_gettime(CLOCK_MONOTONIC, &c->start);
+			// Unix-domain clients have no address and keep 0.0.0.0:0
+			if (getpeername(c->fd, (struct sockaddr *) &client_addr, &client_len) == 0
+				&& client_addr.sin_family == AF_INET)
+			{
+				c->ip = client_addr.sin_addr;
+				c->port = ntohs(client_addr.sin_port);
+			}
+			PrepRecv(ring, c);
+			return;
+
+		case OP_TIMEOUT:
+			// Every waiting read tries again
+			starve_timer = FALSE;
+			while ((c = starved) != NULL)
+			{
+				starved = c->next_starved;
+				PrepRecv(ring, c);
+			}
+			starved_end = &starved;
+			return;
+
+		case OP_RECV:
+			c->inflight--;
+			if (cqe->res <= 0)
+			{
+				// Out of buffers just means try again once some are back
+				if (cqe->res == -ENOBUFS)
+				{
+					Starve(ring, c);
+					return;
+				}
+				c->dead = TRUE;
+				closed = ChainDone(ring, c);
+				break;
+			}
+
+			// Append the chunk to the staging buffer and return the buffer
+			bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			if (c->len + cqe->res > c->cap)
+			{
+				c->cap = c->len + cqe->res > BUF_SIZE ? c->len + cqe->res : BUF_SIZE;
+				if ((c->buf = realloc(c->buf, c->cap)) == NULL)
+					SystemFatal("realloc");
+			}
+			memcpy(c->buf + c->len, buf_base + (size_t) bid * BUF_SIZE, cqe->res);
+			c->len += cqe->res;
+			RecycleBuffer(ring, bid);
+
+			closed = ParseInput(ring, c);
+			break;
+
+		default:
+			// Part of a send / linked recv chain; short transfers fail it
+			c->inflight--;
+			if (cqe->res < 0)
+				c->dead = TRUE;
+			if (c->inflight == 0)
+				closed = ChainDone(ring, c);
+			break;
+	}
+	if (!closed)
+		c->active += TscNow() - cqe_start;
+}
+
+// Queues the echo of every complete frame in the staging buffer and, if a
+// frame is still arriving, a recv of its remaining payload linked to its send.
+// Returns TRUE if c was closed.
+static int ParseInput (struct Ring *ring, struct Connection *c)
+{
+	size_t off = 0, total, have;
+	uint32_t len;
+	int type, rc;
+
+	c->frame = 0;
+	while (!c->closing)
+	{
+		rc = FrameParse((unsigned char *) c->buf + off, c->len - off, &type, &len);
+		if (rc == 0)
+			break;
+		if (rc < 0)
+		{
+			c->dead = TRUE;
+			break;
+		}
+		total = FRAME_HDRLEN + len;
+		if (c->len - off < total)
+		{
+			if (type == FRAME_DATA)
+				c->frame = total;
+			break;
+		}
+		if (type == FRAME_CLOSE)
+		{
+			c->closing = TRUE;
+			break;
+		}
+		c->requests++;
+		c->bytes += len;
+		messages++;
+		off += total;
+	}
+	c->sent = off;
+
+	if (c->dead)
+		return ChainDone(ring, c);
+
+	// Make room for the rest of a partially received frame
+	if (c->frame && off + c->frame > c->cap)
+	{
+		c->cap = off + c->frame;
+		if ((c->buf = realloc(c->buf, c->cap)) == NULL)
+			SystemFatal("realloc");
+	}
+
+	if (off > 0)
+		PrepSendRecv(ring, c, OP_SEND, c->buf, off, c->frame != 0);
+	if (c->frame)
+	{
+		have = c->len - off;
+		PrepSendRecv(ring, c, OP_RECV_REST, c->buf + c->len, c->frame - have, TRUE);
+		PrepSendRecv(ring, c, OP_SEND_FRAME, c->buf + off, c->frame, FALSE);
+	}
+	if (c->inflight == 0)
+		return ChainDone(ring, c);
+	return FALSE;
+}
+
+// Called once nothing is in flight for c: either reads again or closes it.
+// Returns TRUE if c was closed.
+static int ChainDone (struct Ring *ring, struct Connection *c)
+{
+	struct timespec end;
+	struct ConnRecord r;
+
+	if (c->frame && !c->dead)
+	{
+		// The linked recv/send pair echoed one more frame
+		c->requests++;
+		c->bytes += c->frame - FRAME_HDRLEN;
+		messages++;
+		c->sent += c->frame;
+		c->len = c->sent;
+	}
+	c->frame = 0;
+
+	// Keep any partial frame for the next read
+	memmove(c->buf, c->buf + c->sent, c->len - c->sent);
+	c->len -= c->sent;
+	c->sent = 0;
+
+	if (!c->dead && !c->closing)
+	{
+		PrepRecv(ring, c);
+		return FALSE;
+	}
+
+	// Time used is the connection's lifetime
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	c->active += TscNow() - cqe_start;
+	r.number = c->number;
+	r.ip = c->ip.s_addr;
+	r.port = c->port;
+	r.thread = 0;
+	r.requests = c->requests;
+	r.secs = (end.tv_sec - c->start.tv_sec) + (end.tv_nsec - c->start.tv_nsec) / 1e9;
+	r.active_secs = TscToNs(c->active) / 1e9;
+	r.bytes = c->bytes;
+	r.spliced = 0;
+	ConnLogPut(conn_log, 0, &r);	// when full the record is dropped; its number is missing from the log
+	close(c->fd);
+	free(c->buf);
+	free(c);
+	return TRUE;
+}
+
+// Prints the error stored in errno and aborts the program.
+static void SystemFatal (const char *message)
+{
+	perror(message);
+	exit(EXIT_FAILURE);
+}
+
+// Stops the event loop
+static void catch_int (int signo)
+{
+	stop = TRUE;
+}
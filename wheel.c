@@ -0,0 +1,138 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		wheel.c -   Hierarchical timer wheel
+--
+--	FUNCTIONS:		WheelInit
+--				WheelAdd
+--				WheelCancel
+--				WheelAdvance
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	See wheel.h. The slot of a timer at level L is bits 6L..6L+5 of its
+--	expiry tick, as in the classic Linux timer wheel: a timer lands in the
+--	lowest level whose span covers its delay, and the slot it is cascaded
+--	from is always the one for the current period of that level. Slots are
+--	circular doubly-linked lists with a sentinel head. Delays are counted
+--	from the last tick run.
+---------------------------------------------------------------------------------------*/
+#include "wheel.h"
+
+#define SLOT_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_SPAN	(1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+void WheelInit (struct Wheel *wheel, uint64_t tick_ns, uint64_t now_ns)
+{
+	int level, slot;
+
+	wheel->tick_ns = tick_ns;
+	wheel->start = now_ns;
+	wheel->now = 0;
+	wheel->count = 0;
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		for (slot = 0; slot < WHEEL_SLOTS; slot++)
+			wheel->slots[level][slot].next = wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+}
+
+// Links t into the slot for its expiry tick.
+static void Insert (struct Wheel *wheel, struct Timer *t)
+{
+	struct Timer *head;
+	uint64_t delta;
+	int level;
+
+	if (t->expires < wheel->now)
+		t->expires = wheel->now;
+	delta = t->expires - wheel->now;
+	if (delta >= WHEEL_SPAN)
+	{
+		t->expires = wheel->now + WHEEL_SPAN - 1;
+		delta = WHEEL_SPAN - 1;
+	}
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < 1ULL << (WHEEL_BITS * (level + 1)))
+			break;
+
+	head = &wheel->slots[level][(t->expires >> (WHEEL_BITS * level)) & SLOT_MASK];
+	t->next = head;
+	t->prev = head->prev;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+// Arms t to fire delay_ns from now, rearming it if it is pending.
+void WheelAdd (struct Wheel *wheel, struct Timer *t, uint64_t delay_ns)
+{
+	WheelCancel (wheel, t);
+	t->expires = wheel->now + (delay_ns + wheel->tick_ns - 1) / wheel->tick_ns;
+	t->pending = 1;
+	wheel->count++;
+	Insert (wheel, t);
+}
+
+void WheelCancel (struct Wheel *wheel, struct Timer *t)
+{
+	if (!t->pending)
+		return;
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->pending = 0;
+	wheel->count--;
+}
+
+// Moves every timer of an upper-level slot down to where it now belongs.
+static void Cascade (struct Wheel *wheel, struct Timer *head)
+{
+	struct Timer *t, *next;
+
+	t = head->next;
+	head->next = head->prev = head;
+	for (; t != head; t = next)
+	{
+		next = t->next;
+		Insert (wheel, t);
+	}
+}
+
+// Runs every tick up to now_ns and returns the timers that fell due,
+// chained through next, no longer pending.
+struct Timer *WheelAdvance (struct Wheel *wheel, uint64_t now_ns)
+{
+	uint64_t target = (now_ns - wheel->start) / wheel->tick_ns;
+	struct Timer *expired = NULL, **tail = &expired;
+	struct Timer *head, *t;
+	int level, index;
+
+	while (wheel->now <= target)
+	{
+		// Nothing armed: skip the idle ticks
+		if (wheel->count == 0)
+		{
+			wheel->now = target + 1;
+			break;
+		}
+
+		// Level 0 wrapped: bring the next slot of each wrapped level down
+		index = wheel->now & SLOT_MASK;
+		for (level = 1; index == 0 && level < WHEEL_LEVELS; level++)
+		{
+			index = (wheel->now >> (WHEEL_BITS * level)) & SLOT_MASK;
+			Cascade (wheel, &wheel->slots[level][index]);
+		}
+
+		head = &wheel->slots[0][wheel->now & SLOT_MASK];
+		wheel->now++;
+		for (t = head->next; t != head; t = t->next)
+		{
+			t->pending = 0;
+			wheel->count--;
+			*tail = t;
+			tail = &t->next;
+		}
+		*tail = NULL;
+		head->next = head->prev = head;
+	}
+	return expired;
+}
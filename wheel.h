@@ -0,0 +1,63 @@
+/*---------------------------------------------------------------------------------------
+--	SOURCE FILE:		wheel.h -   Hierarchical timer wheel
+--
+--	FUNCTIONS:		WheelInit
+--				WheelAdd
+--				WheelCancel
+--				WheelAdvance
+--
+--	DATE:			October 2026
+--
+--	REVISIONS:		(Date and Description)
+--
+--	NOTES:
+--	Timers are intrusive: a struct Timer lives inside the object it times,
+--	so adding and cancelling one is a list insert or unlink, O(1) whatever
+--	the number of timers. Time moves in ticks of tick_ns. The wheel has
+--	WHEEL_LEVELS levels of WHEEL_SLOTS slots; level 0 holds timers due
+--	within WHEEL_SLOTS ticks, one slot per tick, and each level above covers
+--	WHEEL_SLOTS times the span of the one below. When level 0 wraps, the
+--	next slot of level 1 is redistributed ("cascaded") into level 0, and so
+--	on up, so every timer is touched at most once per level it passes
+--	through. Delays beyond the top level's span are clamped to it.
+--
+--	The owner drives the wheel from a periodic clock (e.g. a timerfd ticking
+--	at tick_ns) by calling WheelAdvance with the current time; it returns
+--	the timers that fell due, unlinked, for the owner to act on. A Wheel
+--	belongs to one thread.
+---------------------------------------------------------------------------------------*/
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WHEEL_BITS	6
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_LEVELS	4	// 2^24 ticks, over 46 hours at 10 ms
+
+struct Timer
+{
+	struct Timer *next, *prev;	// slot list links; next chains expired timers
+	uint64_t expires;		// tick the timer is due
+	int pending;
+};
+
+struct Wheel
+{
+	uint64_t tick_ns;
+	uint64_t start;			// time of tick 0 (ns)
+	uint64_t now;			// next tick to run
+	size_t count;			// timers pending
+	struct Timer slots[WHEEL_LEVELS][WHEEL_SLOTS];	// list heads
+};
+
+void WheelInit (struct Wheel *wheel, uint64_t tick_ns, uint64_t now_ns);
+void WheelAdd (struct Wheel *wheel, struct Timer *t, uint64_t delay_ns);
+void WheelCancel (struct Wheel *wheel, struct Timer *t);
+struct Timer *WheelAdvance (struct Wheel *wheel, uint64_t now_ns);
+
+// The object a Timer is embedded in
+#define TIMER_OWNER(t, type, member)	((type *) ((char *) (t) - offsetof (type, member)))
+
+#endif